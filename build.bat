@@ -6,12 +6,14 @@ REM -- Flags
 
 set Release=0
 set Tools=0
+set CullTest=0
 
 :processargs
 set ARG=%1
 IF DEFINED ARG (
 	IF "%ARG%"=="-r" set Release=1
 	IF "%ARG%"=="-t" set Tools=1
+	IF "%ARG%"=="-c" set CullTest=1
 	SHIFT
 	GOTO processargs
 )
@@ -20,7 +22,15 @@ set UserPath=%HomeDrive%%HomePath%
 set LibPath=%UserPath%\source\libraries
 set SrcPath=..\src
 
-IF %Tools% EQU 0 (
+IF %CullTest% EQU 1 (
+	echo BUILDING CULL TEST
+	set SourceFiles=..\tools\CullTest.cpp %SrcPath%\render\Culling.cpp
+	set CompilerFlags=-Fe: CullTest.exe -MDd -nologo -GR- -Oi -EHa- -W4 -wd4530 -FC -Z7 -std:c++17
+	set LinkerFlags=-opt:ref -incremental:no -NODEFAULTLIB:MSVCRT
+	set Libraries=vulkan-1.lib
+	set IncludePaths=-I %SrcPath% -I C:\VulkanSDK\1.2.131.2\Include -I %LibPath%\glm
+	set LibPaths=-LIBPATH:C:\VulkanSDK\1.2.131.2\Lib
+) ELSE IF %Tools% EQU 0 (
 	echo BUILDING CODE
 	set SourceFiles=%SrcPath%\Unity.cpp
 	set CompilerFlags=-Fe: Arc03.exe -MDd -nologo -GR- -Oi -EHa- -W4 -wd4530 -wd4701 -FC -Z7 -std:c++17
@@ -30,7 +40,7 @@ IF %Tools% EQU 0 (
 	set LibPaths=-LIBPATH:C:\VulkanSDK\1.2.131.2\Lib -LIBPATH:%LibPath%\glfw-3.3.2\bin\Release
 ) ELSE (
 	echo BUILDING TOOLS
-	set SourceFiles=..\tools\bake.cpp
+	set SourceFiles=..\tools\bake.cpp ..\tools\MeshOptimizer.cpp ..\tools\Meshlet.cpp ..\tools\Simplify.cpp ..\tools\VertexEncode.cpp ..\tools\VertexWeld.cpp
 	set CompilerFlags=-MDd -nologo -GR- -Oi -W4 -FC -Z7 -std:c++17
 	set LinkerFlags=-opt:ref -incremental:no -NODEFAULTLIB:MSVCRT
 	set Libraries=user32.lib Gdi32.lib winmm.lib shell32.lib
@@ -1,2 +1,7 @@
 C:\VulkanSDK\1.2.131.2\Bin\glslc.exe shader.vert -o vert.spv
 C:\VulkanSDK\1.2.131.2\Bin\glslc.exe shader.frag -o frag.spv
+C:\VulkanSDK\1.2.131.2\Bin\glslc.exe cull.comp -o cull.spv
+
+C:\VulkanSDK\1.2.131.2\Bin\spirv-val.exe --target-env vulkan1.1 vert.spv
+C:\VulkanSDK\1.2.131.2\Bin\spirv-val.exe --target-env vulkan1.1 frag.spv
+C:\VulkanSDK\1.2.131.2\Bin\spirv-val.exe --target-env vulkan1.1 cull.spv
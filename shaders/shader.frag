@@ -1,20 +1,43 @@
 #version 450
 #extension GL_ARB_separate_shader_objects: enable
 
-layout(binding = 1, set = 2) uniform sampler texSampler;
-layout(binding = 2, set = 2) uniform texture2D textures[4];
+#define DS_TEXTURES 3
 
-layout(push_constant) uniform PushConstants
+// Matches VulkanEngine::MAX_TEXTURES. Partially bound, only slots with a texture loaded are valid.
+#define MAX_TEXTURES 1024
+
+layout(binding = 0, set = DS_TEXTURES) uniform sampler texSampler;
+layout(binding = 1, set = DS_TEXTURES) uniform texture2D textures[MAX_TEXTURES];
+
+// Matches VulkanEngine::MaterialData
+struct MaterialData
+{
+	vec4 baseColor;
+	uint textureIndex;
+};
+
+layout(std430, binding = 2, set = DS_TEXTURES) readonly buffer MaterialTable
 {
-	int textureIdx;
-} pc;
+	MaterialData materials[];
+};
+
+// MaterialFeature bits, set per pipeline so the unused ones compile out
+layout(constant_id = 0) const bool USE_TEXTURE = true;
+layout(constant_id = 1) const bool USE_VERTEX_COLOR = true;
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterialIdx;
 
 layout(location = 0) out vec4 outColor;
 
 void main()
 {
-	outColor = texture(sampler2D(textures[pc.textureIdx], texSampler), fragTexCoord) * vec4(fragColor, 1.0);
+	const MaterialData material = materials[fragMaterialIdx];
+
+	outColor = material.baseColor;
+	if (USE_TEXTURE)
+		outColor *= texture(sampler2D(textures[material.textureIndex], texSampler), fragTexCoord);
+	if (USE_VERTEX_COLOR)
+		outColor.rgb *= fragColor;
 }
@@ -15,9 +15,22 @@ layout(binding = 0, set=DS_FRAME) uniform FrameUniformBuffer
 	mat4 view;
 };
 
-layout(binding = 0, set=DS_DRAW) uniform DrawUniformBuffer
+// Matches VulkanEngine::InstanceData
+struct InstanceData
 {
 	mat4 model;
+	uint materialIdx;
+};
+
+layout(std430, binding = 0, set=DS_DRAW) readonly buffer InstanceBuffer
+{
+	InstanceData instances[];
+};
+
+// Instances drawn by each instanced draw, starting at its firstInstance
+layout(std430, binding = 1, set=DS_DRAW) readonly buffer InstanceIndexBuffer
+{
+	uint instanceIndices[];
 };
 
 layout(location = 0) in vec3 inPosition;
@@ -26,10 +39,14 @@ layout(location = 2) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterialIdx;
 
 void main()
 {
-	gl_Position = proj * view * model * vec4(inPosition, 1.0);
+	const InstanceData instance = instances[instanceIndices[gl_InstanceIndex]];
+
+	gl_Position = proj * view * instance.model * vec4(inPosition, 1.0);
 	fragColor = inColor;
 	fragTexCoord = inTexCoord;
+	fragMaterialIdx = instance.materialIdx;
 }
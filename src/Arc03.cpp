@@ -8,6 +8,9 @@
 #include <array>
 #include <chrono>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <optional>
@@ -30,23 +33,28 @@ class Arc03
 	const std::string MODEL_PATH = "models/chalet.bin";
 	const std::string TEXTURE_PATH = "textures/chalet.jpg";
 
+	// Repeated props under the main models, drawn instanced
+	const u32 PROP_GRID_SIZE = 32;
+	const f32 PROP_SPACING = 0.125f;
+	const f32 PROP_SCALE = 0.04f;
+
 public:
-	void Run()
+	void Run(const FramePacingSettings &framePacing, const CullingSettings &culling)
 	{
 		InitWindow();
 
-		VulkanEngine::Initialize(mWindow, mSurface);
+		VulkanEngine::Initialize(mWindow, mSurface, framePacing, culling);
 		ResourceManager::Initialize();
 		ComponentManager::Initialize();
 
-		LoadTexture(TEXTURE_PATH);
-		LoadTexture("textures/texture.jpg");
-		LoadTexture("textures/gradient.png");
-		LoadTexture("textures/bricks.png");
-		VulkanEngine::Instance()->UpdateDescriptorSets();
+		const u32 chaletMaterial = CreateTexturedMaterial(LoadTexture(TEXTURE_PATH));
+		const u32 monkeyMaterial = CreateTexturedMaterial(LoadTexture("textures/texture.jpg"));
+		mPropMaterials[0] = CreateTexturedMaterial(LoadTexture("textures/gradient.png"));
+		mPropMaterials[1] = CreateTexturedMaterial(LoadTexture("textures/bricks.png"));
 
-		ComponentManager::Instance()->CreateGraphicComponent(MODEL_PATH);
-		ComponentManager::Instance()->CreateGraphicComponent("models/monkey.bin");
+		ComponentManager::Instance()->CreateGraphicComponent(MODEL_PATH, chaletMaterial);
+		ComponentManager::Instance()->CreateGraphicComponent("models/monkey.bin", monkeyMaterial);
+		CreateProps();
 
 		MainLoop();
 		CleanUp();
@@ -64,30 +72,93 @@ private:
 		glfwSetFramebufferSizeCallback(mWindow, VulkanEngine::FramebufferResizeCallback);
 	}
 
-	void LoadTexture(std::string textureFilename)
+	// Returns the texture's slot, which materials refer to it by
+	u32 LoadTexture(std::string textureFilename)
 	{
 		int texWidth, texHeight, texChannels;
 		stbi_uc *pixels = stbi_load(textureFilename.c_str(), &texWidth, &texHeight, &texChannels,
 				STBI_rgb_alpha);
 		ARC_ASSERT(pixels);
 
-		VulkanEngine::Instance()->LoadTextureFromImage(pixels, static_cast<u32>(texWidth),
+		const u32 slot = VulkanEngine::Instance()->LoadTextureFromImage(pixels, static_cast<u32>(texWidth),
 				static_cast<u32>(texHeight));
 
 		stbi_image_free(pixels);
+		return slot;
+	}
+
+	// Texture tinted by the vertex colors
+	u32 CreateTexturedMaterial(u32 textureSlot)
+	{
+		const Material material = { MATERIALFEATURE_TEXTURE | MATERIALFEATURE_VERTEX_COLOR, textureSlot,
+				glm::vec4(1.0f) };
+		return VulkanEngine::Instance()->CreateMaterial(material);
 	}
 
 	void MainLoop()
 	{
 		while (!glfwWindowShouldClose(mWindow))
 		{
+			VulkanEngine::Instance()->BeginFrame();
 			glfwPollEvents();
+			UpdateScene();
 			VulkanEngine::Instance()->DrawFrame();
+			UpdateWindowTitle();
 		}
 
 		VulkanEngine::Instance()->WaitForDevice();
 	}
 
+	void CreateProps()
+	{
+		const f32 extent = (PROP_GRID_SIZE - 1) * PROP_SPACING;
+		for (u32 y = 0; y < PROP_GRID_SIZE; ++y)
+		{
+			for (u32 x = 0; x < PROP_GRID_SIZE; ++x)
+			{
+				ComponentManager::Instance()->CreateGraphicComponent("models/monkey.bin", mPropMaterials[(x + y) % 2]);
+
+				const glm::vec3 position(x * PROP_SPACING - extent * 0.5f, y * PROP_SPACING - extent * 0.5f, -0.5f);
+				const u32 index = ComponentManager::Instance()->GetGraphicComponentCount() - 1;
+				ComponentManager::Instance()->GetGraphicComponent(index).mTransform = glm::scale(
+						glm::translate(glm::mat4(1.0f), position), glm::vec3(PROP_SCALE));
+			}
+		}
+	}
+
+	void UpdateScene()
+	{
+		static auto startTime = std::chrono::high_resolution_clock::now();
+
+		auto currentTime = std::chrono::high_resolution_clock::now();
+		const float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+
+		ComponentManager::Instance()->GetGraphicComponent(0).mTransform = glm::rotate(glm::mat4(1.0f),
+				time * glm::radians(45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		ComponentManager::Instance()->GetGraphicComponent(1).mTransform = glm::rotate(glm::translate(glm::mat4(1.0f),
+				glm::vec3(1.0f, 0.0f, 0.0f)), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	}
+
+	void UpdateWindowTitle()
+	{
+		// Setting the title every frame is surprisingly slow on some platforms
+		static auto lastUpdate = std::chrono::high_resolution_clock::now();
+		auto currentTime = std::chrono::high_resolution_clock::now();
+		if (currentTime - lastUpdate < std::chrono::milliseconds(250))
+			return;
+		lastUpdate = currentTime;
+
+		const FrameStats &stats = VulkanEngine::Instance()->GetFrameStats();
+		char title[256];
+		snprintf(title, sizeof(title),
+				"Vulkan window - components %u/%u, meshlets %u/%u, %u draws (%u recorded), %u binds (%u redundant), "
+				"%u triangles, %.1f ms latency",
+				stats.mVisibleComponents, stats.mVisibleComponents + stats.mCulledComponents, stats.mVisibleMeshlets,
+				stats.mVisibleMeshlets + stats.mCulledMeshlets, stats.mDrawCalls, stats.mRecordedDrawCalls, stats.mBinds,
+				stats.mRedundantBinds, stats.mTriangles, stats.mInputLatencyMs);
+		glfwSetWindowTitle(mWindow, title);
+	}
+
 	void CleanUp()
 	{
 		VulkanEngine::Instance()->CleanUp();
@@ -96,16 +167,33 @@ private:
 		glfwTerminate();
 	}
 
+	// Alternating in a checkerboard
+	std::array<u32, 2> mPropMaterials;
+
 	// Window
 	GLFWwindow *mWindow;
 	VkSurfaceKHR mSurface;
 	std::vector<VkImageView> mSwapChainImageViews;
 };
 
-int main()
+int main(int argc, char **argv)
 {
+	// -throughput for offline renders, -frames N to override the frames in flight, -cpuculling to cull
+	// components and meshlets on the CPU
+	FramePacingSettings framePacing;
+	CullingSettings culling;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-throughput") == 0)
+			framePacing.mMode = FRAMEPACING_HIGH_THROUGHPUT;
+		else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+			framePacing.mFramesInFlight = static_cast<u32>(std::max(1, atoi(argv[++i])));
+		else if (strcmp(argv[i], "-cpuculling") == 0)
+			culling.mGpuCulling = false;
+	}
+
 	Arc03 app;
-	app.Run();
+	app.Run(framePacing, culling);
 
 	return EXIT_SUCCESS;
 }
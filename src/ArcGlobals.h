@@ -38,7 +38,7 @@ typedef double f64;
 #endif
 
 #ifdef ARC_DEBUG
-#define ARC_ASSERT(expr) do { if (!expr) ARC_BREAK(); } while (false)
+#define ARC_ASSERT(expr) do { if (!(expr)) ARC_BREAK(); } while (false)
 #else
 #define ARC_ASSERT(expr) expr
 #endif
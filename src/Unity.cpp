@@ -8,5 +8,11 @@
 #include "engine/ResourceManager.cpp"
 #pragma message("memory/GpuAllocator.cpp")
 #include "memory/GpuAllocator.cpp"
+#pragma message("memory/VertexAllocator.cpp")
+#include "memory/VertexAllocator.cpp"
+#pragma message("render/CommandStateTracker.cpp")
+#include "render/CommandStateTracker.cpp"
+#pragma message("render/Culling.cpp")
+#include "render/Culling.cpp"
 #pragma message("render/VulkanEngine.cpp")
 #include "render/VulkanEngine.cpp"
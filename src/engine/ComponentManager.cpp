@@ -8,10 +8,10 @@ void ComponentManager::Initialize()
 	sInstance = &instance;
 }
 
-const GraphicComponent &ComponentManager::CreateGraphicComponent(std::string resourceFilename)
+const GraphicComponent &ComponentManager::CreateGraphicComponent(std::string resourceFilename, u32 materialIndex)
 {
 	Resource *const resource = ResourceManager::Instance()->LoadResource(resourceFilename);
 	GraphicResource *graphicResource = static_cast<GraphicResource *>(resource);
-	mGraphicComponents.push_back(GraphicComponent { graphicResource });
+	mGraphicComponents.push_back(GraphicComponent { graphicResource, glm::mat4(1.0f), 0, materialIndex });
 	return mGraphicComponents[mGraphicComponents.size() - 1];
 }
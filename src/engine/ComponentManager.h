@@ -9,6 +9,11 @@
 struct GraphicComponent
 {
 	GraphicResource *mGraphicResource;
+	glm::mat4 mTransform;
+	// Picked every frame by the renderer, kept around for hysteresis
+	u32 mLod;
+	// Slot in the engine's material table
+	u32 mMaterialIndex;
 };
 
 class ComponentManager
@@ -30,5 +35,8 @@ public:
 	{
 		return mGraphicComponents.end();
 	}
-	const GraphicComponent &CreateGraphicComponent(std::string resourceFilename);
+	u32 GetGraphicComponentCount() const { return static_cast<u32>(mGraphicComponents.size()); }
+	GraphicComponent &GetGraphicComponent(u32 index) { return mGraphicComponents[index]; }
+	// Components created from the same file share their resource
+	const GraphicComponent &CreateGraphicComponent(std::string resourceFilename, u32 materialIndex = 0);
 };
@@ -8,18 +8,60 @@ void GraphicResource::Load(void *data, u64 dataSize)
 	ARC_UNUSED(dataSize);
 	u8 *readPtr = (u8 *)data;
 
-	mVertexCount = *(u32 *)readPtr;
-	readPtr += 4;
-	mIndexCount = *(u32 *)readPtr;
-	readPtr += 4;
+	const GraphicResourceHeader *header = (GraphicResourceHeader *)readPtr;
+	readPtr += sizeof(GraphicResourceHeader);
 
-	const size_t vertexDataSize = sizeof(Vertex) * mVertexCount;
-	const size_t indexDataSize = sizeof(u32) * mIndexCount;
+	mVertexCount = header->mVertexCount;
+	mIndexCount = header->mIndexCount;
+	mIndexSize = header->mIndexSize;
+	ARC_ASSERT(mIndexSize == sizeof(u16) || mIndexSize == sizeof(u32));
+	mVertexLayout = header->mVertexLayout;
+	mPositionOffset = glm::vec3(header->mPositionOffset[0], header->mPositionOffset[1], header->mPositionOffset[2]);
+	mPositionScale = glm::vec3(header->mPositionScale[0], header->mPositionScale[1], header->mPositionScale[2]);
+	mBoundsMin = glm::vec3(header->mBoundsMin[0], header->mBoundsMin[1], header->mBoundsMin[2]);
+	mBoundsMax = glm::vec3(header->mBoundsMax[0], header->mBoundsMax[1], header->mBoundsMax[2]);
+	mBoundsCenter = glm::vec3(header->mBoundsCenter[0], header->mBoundsCenter[1], header->mBoundsCenter[2]);
+	mBoundsRadius = header->mBoundsRadius;
 
-	u64 vbOffset = ResourceManager::Instance()->GetVertexAllocator().Allocate(vertexDataSize);
-	VulkanEngine::Instance()->FillVertexBuffer((void *)readPtr, vbOffset, vertexDataSize);
-	readPtr += vertexDataSize;
+	const size_t positionDataSize = static_cast<size_t>(mVertexLayout.GetPositionStride()) * mVertexCount;
+	const size_t attributeDataSize = static_cast<size_t>(mVertexLayout.GetAttributeStride()) * mVertexCount;
+	const size_t indexDataSize = GetIndexDataSize();
 
-	mIndexBufferOffset = ResourceManager::Instance()->GetIndexAllocator().Allocate(indexDataSize);
+	// Both streams start at the same vertex number, indices are aligned so draws can address them by
+	// index number
+	VertexAllocator &vertexAllocator = ResourceManager::Instance()->GetVertexAllocator();
+	mFirstVertex = vertexAllocator.AllocateVertices(mVertexCount, mVertexLayout.GetPositionStride(),
+			mVertexLayout.GetAttributeStride());
+
+	mPositionBufferOffset = vertexAllocator.GetPositionHeapOffset() +
+			static_cast<u64>(mFirstVertex) * mVertexLayout.GetPositionStride();
+	VulkanEngine::Instance()->FillVertexBuffer((void *)readPtr, mPositionBufferOffset, positionDataSize);
+	readPtr += positionDataSize;
+
+	mAttributeBufferOffset = vertexAllocator.GetAttributeHeapOffset() +
+			static_cast<u64>(mFirstVertex) * mVertexLayout.GetAttributeStride();
+	VulkanEngine::Instance()->FillVertexBuffer((void *)readPtr, mAttributeBufferOffset, attributeDataSize);
+	readPtr += attributeDataSize;
+
+	mConstantAttributeOffset = 0;
+	if (mVertexLayout.HasConstantAttributes())
+	{
+		const size_t constantDataSize = sizeof(header->mConstantColor);
+		mConstantAttributeOffset = vertexAllocator.Allocate(constantDataSize, sizeof(f32));
+		VulkanEngine::Instance()->FillVertexBuffer((void *)header->mConstantColor, mConstantAttributeOffset,
+				constantDataSize);
+	}
+
+	mIndexBufferOffset = ResourceManager::Instance()->GetIndexAllocator().Allocate(indexDataSize, mIndexSize);
 	VulkanEngine::Instance()->FillIndexBuffer((void *)readPtr, mIndexBufferOffset, indexDataSize);
+	readPtr += indexDataSize;
+
+	// Only used for culling and LOD selection on the CPU, never uploaded
+	mMeshlets.resize(header->mMeshletCount);
+	memcpy(mMeshlets.data(), readPtr, sizeof(Meshlet) * header->mMeshletCount);
+	readPtr += sizeof(Meshlet) * header->mMeshletCount;
+
+	ARC_ASSERT(header->mLodCount > 0);
+	mLods.resize(header->mLodCount);
+	memcpy(mLods.data(), readPtr, sizeof(MeshLod) * header->mLodCount);
 }
@@ -4,18 +4,60 @@
 #include "memory/Memory.h"
 #include "memory/GpuAllocator.h"
 #include "engine/Resource.h"
+#include "util/Geometry.h"
+#include "util/VertexLayout.h"
+
+#include <vector>
 
 class GraphicResource : public Resource
 {
+	friend class ResourceManager;
+
+	// Position among the loaded graphic resources
+	u32 mIndex;
+	u64 mPositionBufferOffset;
+	u64 mAttributeBufferOffset;
+	u64 mConstantAttributeOffset;
 	u64 mIndexBufferOffset;
+	u32 mFirstVertex;
 	u32 mVertexCount;
 	u32 mIndexCount;
+	u32 mIndexSize;
+	VertexLayout mVertexLayout;
+	glm::vec3 mPositionOffset;
+	glm::vec3 mPositionScale;
+	glm::vec3 mBoundsMin;
+	glm::vec3 mBoundsMax;
+	glm::vec3 mBoundsCenter;
+	f32 mBoundsRadius;
+	std::vector<Meshlet> mMeshlets;
+	std::vector<MeshLod> mLods;
 
 public:
+	u32 GetIndex() const { return mIndex; }
+	u64 GetPositionBufferOffset() const { return mPositionBufferOffset; }
+	u64 GetAttributeBufferOffset() const { return mAttributeBufferOffset; }
+	u64 GetConstantAttributeOffset() const { return mConstantAttributeOffset; }
+	// Vertex number of the first vertex in both vertex heaps
+	u32 GetFirstVertex() const { return mFirstVertex; }
+	const VertexLayout &GetVertexLayout() const { return mVertexLayout; }
+	// Maps stored positions back to object space, meant to be folded into the model matrix
+	glm::mat4 GetPositionTransform() const
+	{
+		return glm::scale(glm::translate(glm::mat4(1.0f), mPositionOffset), mPositionScale);
+	}
+	// Object space
+	const glm::vec3 &GetBoundsMin() const { return mBoundsMin; }
+	const glm::vec3 &GetBoundsMax() const { return mBoundsMax; }
+	const glm::vec3 &GetBoundsCenter() const { return mBoundsCenter; }
+	f32 GetBoundsRadius() const { return mBoundsRadius; }
 	u64 GetIndexBufferOffset() const { return mIndexBufferOffset; }
 	u32 GetVertexCount() const { return mVertexCount; }
 	u32 GetIndexCount() const { return mIndexCount; }
-	u64 GetIndexDataSize() const { return mIndexCount * sizeof(u32); }
+	u32 GetIndexSize() const { return mIndexSize; }
+	u64 GetIndexDataSize() const { return static_cast<u64>(mIndexCount) * mIndexSize; }
+	const std::vector<Meshlet> &GetMeshlets() const { return mMeshlets; }
+	const std::vector<MeshLod> &GetLods() const { return mLods; }
 
 protected:
 	void Load(void *data, u64 dataSize) final;
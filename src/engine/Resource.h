@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ArcGlobals.h"
+#include "util/VertexLayout.h"
 
 enum ResourceType
 {
@@ -15,6 +16,60 @@ struct ResourceHeader
 	u64 mSize;
 };
 
+// Cluster of up to MAX_VERTICES vertices and MAX_TRIANGLES triangles, stored as a contiguous range of
+// the mesh's indices. Bounds are in object space.
+struct Meshlet
+{
+	static const u32 MAX_VERTICES = 64;
+	static const u32 MAX_TRIANGLES = 124;
+
+	f32 mCenter[3];
+	f32 mRadius;
+	// Every triangle is back facing when seen from a point p where
+	// dot(normalize(mConeApex - p), mConeAxis) >= mConeCutoff. A cutoff of 1 means never.
+	f32 mConeApex[3];
+	f32 mConeCutoff;
+	f32 mConeAxis[3];
+	// Relative to the first index of the mesh
+	u32 mIndexOffset;
+	u32 mIndexCount;
+};
+
+// Index and meshlet ranges of one level of detail. LOD 0 is the full mesh, all of them share the
+// same vertices.
+struct MeshLod
+{
+	u32 mIndexOffset;
+	u32 mIndexCount;
+	u32 mMeshletOffset;
+	u32 mMeshletCount;
+	// Object space distance the surface may have moved from the full mesh
+	f32 mError;
+};
+
+// Followed by the position stream, the attribute stream, the index data, the meshlets and then the
+// LODs
+struct GraphicResourceHeader
+{
+	u32 mVertexCount;
+	u32 mIndexCount;
+	u32 mMeshletCount;
+	u32 mLodCount;
+	// 2 for meshes with up to 65536 vertices, 4 otherwise
+	u32 mIndexSize;
+	VertexLayout mVertexLayout;
+	// Object space position is mPositionOffset + stored position * mPositionScale
+	f32 mPositionOffset[3];
+	f32 mPositionScale[3];
+	// Values of the attributes the layout leaves out of the vertex stream
+	f32 mConstantColor[4];
+	// Object space bounds of the full mesh
+	f32 mBoundsMin[3];
+	f32 mBoundsMax[3];
+	f32 mBoundsCenter[3];
+	f32 mBoundsRadius;
+};
+
 class Resource
 {
 	friend class ResourceManager;
@@ -22,6 +22,7 @@ Resource *ResourceManager::AllocateResource(ResourceHeader header)
 		case RESOURCETYPE_GRAPHIC:
 		{
 			mGraphicResources.resize(mGraphicResources.size() + 1);
+			mGraphicResources.back().mIndex = static_cast<u32>(mGraphicResources.size() - 1);
 			return &mGraphicResources.back();
 		} break;
 	};
@@ -30,6 +31,10 @@ Resource *ResourceManager::AllocateResource(ResourceHeader header)
 
 Resource *ResourceManager::LoadResource(std::string filename)
 {
+	auto loaded = mLoadedResources.find(filename);
+	if (loaded != mLoadedResources.end())
+		return loaded->second;
+
 	std::ifstream file;
 	file.open(filename.c_str(), std::ios::binary);
 
@@ -45,5 +50,6 @@ Resource *ResourceManager::LoadResource(std::string filename)
 	resource->Load(data, header.mSize);
 
 	free(data);
+	mLoadedResources[filename] = resource;
 	return resource;
 }
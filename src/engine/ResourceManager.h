@@ -4,7 +4,10 @@
 #include "engine/GraphicResource.h"
 #include "memory/Memory.h"
 #include "memory/GpuAllocator.h"
+#include "memory/VertexAllocator.h"
 
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 class VulkanEngine;
@@ -19,15 +22,17 @@ protected:
 	ResourceManager() = default;
 
 	VulkanEngine *mVulkanEngine;
-	GpuAllocator mGpuVertexAllocator { VERTEX_BUFFER_SIZE };
+	VertexAllocator mGpuVertexAllocator { VERTEX_BUFFER_SIZE, POSITION_HEAP_SIZE };
 	GpuAllocator mGpuIndexAllocator { INDEX_BUFFER_SIZE };
 
 	std::vector<GraphicResource> mGraphicResources;
+	// Loaded resources by file name
+	std::unordered_map<std::string, Resource *> mLoadedResources;
 
 public:
 	static void Initialize();
 	Resource *AllocateResource(ResourceHeader header);
 	Resource *LoadResource(std::string filename);
-	GpuAllocator &GetVertexAllocator() { return mGpuVertexAllocator; }
+	VertexAllocator &GetVertexAllocator() { return mGpuVertexAllocator; }
 	GpuAllocator &GetIndexAllocator() { return mGpuIndexAllocator; }
 };
@@ -7,3 +7,12 @@ size_t GpuAllocator::Allocate(size_t size)
 	return start;
 }
 
+size_t GpuAllocator::Allocate(size_t size, size_t alignment)
+{
+	// Alignment doesn't need to be a power of two, vertex strides aren't
+	const size_t misalignment = mUsed % alignment;
+	if (misalignment != 0)
+		mUsed += alignment - misalignment;
+	return Allocate(size);
+}
+
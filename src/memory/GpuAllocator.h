@@ -8,5 +8,6 @@ class GpuAllocator
 public:
 	GpuAllocator(size_t bufferSize) : mBufferSize(bufferSize), mUsed(0) {}
 	size_t Allocate(size_t size);
+	size_t Allocate(size_t size, size_t alignment);
 };
 
@@ -7,4 +7,6 @@
 #define GIGABYTES(n) ((u64)MEGABYTES(n) * 1024)
 
 #define VERTEX_BUFFER_SIZE MEGABYTES(128)
+// Start of the vertex buffer, the rest holds the other attributes
+#define POSITION_HEAP_SIZE MEGABYTES(48)
 #define INDEX_BUFFER_SIZE MEGABYTES(64)
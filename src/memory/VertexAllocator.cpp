@@ -0,0 +1,28 @@
+#include "VertexAllocator.h"
+
+#include <algorithm>
+
+u32 VertexAllocator::AllocateVertices(u32 vertexCount, u32 positionStride, u32 attributeStride)
+{
+	// First vertex number past the end of both heaps. Strides change between layouts, so one of the
+	// heaps may be left with a gap.
+	const size_t firstVertex = std::max((mPositionUsed + positionStride - 1) / positionStride,
+			(mAttributeUsed + attributeStride - 1) / attributeStride);
+	mPositionUsed = (firstVertex + vertexCount) * positionStride;
+	mAttributeUsed = (firstVertex + vertexCount) * attributeStride;
+	ARC_ASSERT(mPositionUsed <= mPositionHeapSize);
+	ARC_ASSERT(GetAttributeHeapOffset() + mAttributeUsed <= mBufferSize);
+	return static_cast<u32>(firstVertex);
+}
+
+size_t VertexAllocator::Allocate(size_t size, size_t alignment)
+{
+	// Alignment is relative to the buffer, the heap itself starts at an arbitrary offset
+	size_t start = GetAttributeHeapOffset() + mAttributeUsed;
+	const size_t misalignment = start % alignment;
+	if (misalignment != 0)
+		start += alignment - misalignment;
+	mAttributeUsed = start + size - GetAttributeHeapOffset();
+	ARC_ASSERT(GetAttributeHeapOffset() + mAttributeUsed <= mBufferSize);
+	return start;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ArcGlobals.h"
+
+// Splits the vertex buffer into a position heap followed by an attribute heap, and hands out vertex
+// ranges that start at the same vertex number in both. With each heap bound once, any mesh can be
+// drawn through vertexOffset alone.
+class VertexAllocator
+{
+	const size_t mBufferSize;
+	const size_t mPositionHeapSize;
+	// Bytes used in each heap
+	size_t mPositionUsed;
+	size_t mAttributeUsed;
+
+public:
+	VertexAllocator(size_t bufferSize, size_t positionHeapSize) : mBufferSize(bufferSize),
+		mPositionHeapSize(positionHeapSize), mPositionUsed(0), mAttributeUsed(0) {}
+	// Returns the first vertex of the range
+	u32 AllocateVertices(u32 vertexCount, u32 positionStride, u32 attributeStride);
+	// Data that isn't indexed by vertex, placed in the attribute heap. Returns its offset in the buffer.
+	size_t Allocate(size_t size, size_t alignment);
+	size_t GetPositionHeapOffset() const { return 0; }
+	size_t GetAttributeHeapOffset() const { return mPositionHeapSize; }
+};
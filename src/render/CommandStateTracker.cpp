@@ -0,0 +1,140 @@
+#include "CommandStateTracker.h"
+
+#include <algorithm>
+#include <cstring>
+
+CommandStateTracker::CommandStateTracker(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint) :
+		mCommandBuffer(commandBuffer), mBindPoint(bindPoint)
+{
+}
+
+void CommandStateTracker::BindPipeline(VkPipeline pipeline)
+{
+	if (pipeline == mPipeline)
+	{
+		++mStats.mRedundantBinds;
+		return;
+	}
+
+	vkCmdBindPipeline(mCommandBuffer, mBindPoint, pipeline);
+	mPipeline = pipeline;
+	++mStats.mBinds;
+}
+
+void CommandStateTracker::BindDescriptorSet(VkPipelineLayout layout, u32 set, VkDescriptorSet descriptorSet,
+		u32 dynamicOffsetCount, const u32 *dynamicOffsets)
+{
+	ARC_ASSERT(set < MAX_DESCRIPTOR_SETS && dynamicOffsetCount <= MAX_DYNAMIC_OFFSETS);
+
+	SetLayout(layout);
+
+	BoundDescriptorSet &bound = mDescriptorSets[set];
+	const u32 dynamicOffsetSize = sizeof(u32) * dynamicOffsetCount;
+	if (bound.mSet == descriptorSet && bound.mDynamicOffsetCount == dynamicOffsetCount &&
+			(dynamicOffsetCount == 0 || memcmp(bound.mDynamicOffsets, dynamicOffsets, dynamicOffsetSize) == 0))
+	{
+		++mStats.mRedundantBinds;
+		return;
+	}
+
+	vkCmdBindDescriptorSets(mCommandBuffer, mBindPoint, layout, set, 1, &descriptorSet, dynamicOffsetCount,
+			dynamicOffsets);
+	bound.mSet = descriptorSet;
+	bound.mDynamicOffsetCount = dynamicOffsetCount;
+	if (dynamicOffsetCount > 0)
+		memcpy(bound.mDynamicOffsets, dynamicOffsets, dynamicOffsetSize);
+	++mStats.mBinds;
+}
+
+void CommandStateTracker::BindVertexBuffers(u32 firstBinding, u32 bindingCount, const VkBuffer *buffers,
+		const VkDeviceSize *offsets)
+{
+	ARC_ASSERT(firstBinding + bindingCount <= MAX_VERTEX_BINDINGS);
+
+	u32 first = bindingCount;
+	u32 last = 0;
+	for (u32 i = 0; i < bindingCount; ++i)
+	{
+		const u32 binding = firstBinding + i;
+		if (mVertexBuffers[binding] == buffers[i] && mVertexBufferOffsets[binding] == offsets[i])
+			continue;
+		first = std::min(first, i);
+		last = i;
+	}
+
+	if (first == bindingCount)
+	{
+		++mStats.mRedundantBinds;
+		return;
+	}
+
+	// Unchanged bindings in between are bound again, one call is cheaper than several
+	vkCmdBindVertexBuffers(mCommandBuffer, firstBinding + first, last - first + 1, buffers + first, offsets + first);
+	for (u32 i = first; i <= last; ++i)
+	{
+		mVertexBuffers[firstBinding + i] = buffers[i];
+		mVertexBufferOffsets[firstBinding + i] = offsets[i];
+	}
+	++mStats.mBinds;
+}
+
+void CommandStateTracker::BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+{
+	if (buffer == mIndexBuffer && offset == mIndexBufferOffset && indexType == mIndexType)
+	{
+		++mStats.mRedundantBinds;
+		return;
+	}
+
+	vkCmdBindIndexBuffer(mCommandBuffer, buffer, offset, indexType);
+	mIndexBuffer = buffer;
+	mIndexBufferOffset = offset;
+	mIndexType = indexType;
+	++mStats.mBinds;
+}
+
+void CommandStateTracker::PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, u32 offset, u32 size,
+		const void *values)
+{
+	ARC_ASSERT(offset + size <= MAX_PUSH_CONSTANT_SIZE);
+
+	SetLayout(layout);
+
+	const u32 end = offset + size;
+	if (stages == mPushConstantStages && offset >= mPushConstantsBegin && end <= mPushConstantsEnd &&
+			memcmp(mPushConstants + offset, values, size) == 0)
+	{
+		++mStats.mRedundantBinds;
+		return;
+	}
+
+	vkCmdPushConstants(mCommandBuffer, layout, stages, offset, size, values);
+	memcpy(mPushConstants + offset, values, size);
+
+	// Keep a single known range, grown when the new one touches it and replaced otherwise
+	if (stages == mPushConstantStages && offset <= mPushConstantsEnd && end >= mPushConstantsBegin)
+	{
+		mPushConstantsBegin = std::min(mPushConstantsBegin, offset);
+		mPushConstantsEnd = std::max(mPushConstantsEnd, end);
+	}
+	else
+	{
+		mPushConstantStages = stages;
+		mPushConstantsBegin = offset;
+		mPushConstantsEnd = end;
+	}
+	++mStats.mBinds;
+}
+
+void CommandStateTracker::SetLayout(VkPipelineLayout layout)
+{
+	if (layout == mLayout)
+		return;
+
+	mLayout = layout;
+	for (BoundDescriptorSet &bound : mDescriptorSets)
+		bound = {};
+	mPushConstantStages = 0;
+	mPushConstantsBegin = 0;
+	mPushConstantsEnd = 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "ArcGlobals.h"
+
+struct CommandStateStats
+{
+	// Binds and push constants that made it into the command buffer
+	u32 mBinds = 0;
+	// The ones dropped because the same state was already set
+	u32 mRedundantBinds = 0;
+};
+
+// Sits between recording code and a command buffer, drops binds and push constants that wouldn't
+// change anything. It only knows what was set through it, so everything a command buffer binds at its
+// bind point has to go through the same tracker.
+class CommandStateTracker
+{
+	ARC_DISABLE_COPY(CommandStateTracker);
+
+public:
+	static const u32 MAX_DESCRIPTOR_SETS = 8;
+	static const u32 MAX_DYNAMIC_OFFSETS = 4;
+	static const u32 MAX_VERTEX_BINDINGS = 8;
+	// Minimum maxPushConstantsSize the spec guarantees
+	static const u32 MAX_PUSH_CONSTANT_SIZE = 128;
+
+	explicit CommandStateTracker(VkCommandBuffer commandBuffer,
+			VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+	void BindPipeline(VkPipeline pipeline);
+	// Binding with another layout forgets every set and push constant, even the compatible ones
+	void BindDescriptorSet(VkPipelineLayout layout, u32 set, VkDescriptorSet descriptorSet,
+			u32 dynamicOffsetCount = 0, const u32 *dynamicOffsets = nullptr);
+	// Only the range from the first to the last binding that changed is bound
+	void BindVertexBuffers(u32 firstBinding, u32 bindingCount, const VkBuffer *buffers, const VkDeviceSize *offsets);
+	void BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+	void PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, u32 offset, u32 size, const void *values);
+
+	VkCommandBuffer GetCommandBuffer() const { return mCommandBuffer; }
+	const CommandStateStats &GetStats() const { return mStats; }
+
+private:
+	struct BoundDescriptorSet
+	{
+		VkDescriptorSet mSet;
+		u32 mDynamicOffsetCount;
+		u32 mDynamicOffsets[MAX_DYNAMIC_OFFSETS];
+	};
+
+	void SetLayout(VkPipelineLayout layout);
+
+	VkCommandBuffer mCommandBuffer;
+	VkPipelineBindPoint mBindPoint;
+	CommandStateStats mStats;
+
+	VkPipeline mPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout mLayout = VK_NULL_HANDLE;
+	BoundDescriptorSet mDescriptorSets[MAX_DESCRIPTOR_SETS] = {};
+
+	VkBuffer mVertexBuffers[MAX_VERTEX_BINDINGS] = {};
+	VkDeviceSize mVertexBufferOffsets[MAX_VERTEX_BINDINGS] = {};
+
+	VkBuffer mIndexBuffer = VK_NULL_HANDLE;
+	VkDeviceSize mIndexBufferOffset = 0;
+	VkIndexType mIndexType = VK_INDEX_TYPE_MAX_ENUM;
+
+	// Only [mPushConstantsBegin, mPushConstantsEnd) is known
+	VkShaderStageFlags mPushConstantStages = 0;
+	u32 mPushConstantsBegin = 0;
+	u32 mPushConstantsEnd = 0;
+	u8 mPushConstants[MAX_PUSH_CONSTANT_SIZE];
+};
@@ -0,0 +1,78 @@
+#include "Culling.h"
+
+#include <algorithm>
+#include <emmintrin.h>
+
+void SphereBoundsSoA::Clear()
+{
+	mCenterX.clear();
+	mCenterY.clear();
+	mCenterZ.clear();
+	mRadius.clear();
+	mCount = 0;
+}
+
+void SphereBoundsSoA::Add(const glm::vec3 &center, f32 radius)
+{
+	// Grow a whole group of four at a time, the padding is never reported as visible
+	if (mCount % 4 == 0)
+	{
+		const size_t paddedCount = mCount + 4;
+		mCenterX.resize(paddedCount, 0.0f);
+		mCenterY.resize(paddedCount, 0.0f);
+		mCenterZ.resize(paddedCount, 0.0f);
+		mRadius.resize(paddedCount, 0.0f);
+	}
+
+	mCenterX[mCount] = center.x;
+	mCenterY[mCount] = center.y;
+	mCenterZ[mCount] = center.z;
+	mRadius[mCount] = radius;
+	++mCount;
+}
+
+u32 CullSpheres(const Frustum &frustum, const SphereBoundsSoA &spheres, std::vector<u8> &visibility)
+{
+	visibility.resize(spheres.mCount);
+
+	__m128 planeX[Frustum::PLANE_COUNT];
+	__m128 planeY[Frustum::PLANE_COUNT];
+	__m128 planeZ[Frustum::PLANE_COUNT];
+	__m128 planeW[Frustum::PLANE_COUNT];
+	for (int p = 0; p < Frustum::PLANE_COUNT; ++p)
+	{
+		planeX[p] = _mm_set1_ps(frustum.mPlanes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.mPlanes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.mPlanes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.mPlanes[p].w);
+	}
+
+	u32 visibleCount = 0;
+	for (u32 i = 0; i < spheres.mCount; i += 4)
+	{
+		const __m128 centerX = _mm_loadu_ps(&spheres.mCenterX[i]);
+		const __m128 centerY = _mm_loadu_ps(&spheres.mCenterY[i]);
+		const __m128 centerZ = _mm_loadu_ps(&spheres.mCenterZ[i]);
+		const __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.mRadius[i]));
+
+		// Visible unless completely behind one of the planes
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < Frustum::PLANE_COUNT; ++p)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(planeX[p], centerX), planeW[p]);
+			distance = _mm_add_ps(_mm_mul_ps(planeY[p], centerY), distance);
+			distance = _mm_add_ps(_mm_mul_ps(planeZ[p], centerZ), distance);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		const u32 groupEnd = std::min(i + 4, spheres.mCount);
+		for (u32 j = i; j < groupEnd; ++j)
+		{
+			visibility[j] = static_cast<u8>((mask >> (j - i)) & 1);
+			visibleCount += visibility[j];
+		}
+	}
+
+	return visibleCount;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ArcGlobals.h"
+#include "util/Frustum.h"
+
+#include <vector>
+
+// Bounding spheres stored as one array per component so they can be tested four at a time. The
+// arrays are padded to a multiple of four.
+struct SphereBoundsSoA
+{
+	std::vector<f32> mCenterX;
+	std::vector<f32> mCenterY;
+	std::vector<f32> mCenterZ;
+	std::vector<f32> mRadius;
+	u32 mCount = 0;
+
+	void Clear();
+	void Add(const glm::vec3 &center, f32 radius);
+};
+
+// Sets visibility[i] to 1 for every sphere that touches the frustum and 0 for the rest. Returns
+// how many are visible.
+u32 CullSpheres(const Frustum &frustum, const SphereBoundsSoA &spheres, std::vector<u8> &visibility);
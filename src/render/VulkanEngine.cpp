@@ -1,50 +1,85 @@
 #include "VulkanEngine.h"
 
+#include <algorithm>
+#include <filesystem>
+
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
-#include <chrono>
-
 #include "engine/ComponentManager.h"
 #include "memory/Memory.h"
+#include "render/CommandStateTracker.h"
+#include "util/Frustum.h"
 #include "util/Geometry.h"
 
 VulkanEngine *VulkanEngine::sInstance;
 
-void VulkanEngine::Initialize(GLFWwindow *window, VkSurfaceKHR surface)
+void VulkanEngine::Initialize(GLFWwindow *window, VkSurfaceKHR surface, const FramePacingSettings &framePacing,
+		const CullingSettings &culling)
 {
 	static VulkanEngine instance;
 	sInstance = &instance;
 
 	sInstance->mWindow = window;
 	sInstance->mSurface = surface;
+	sInstance->mFramePacing = framePacing;
+	sInstance->mFramesInFlight = framePacing.GetFramesInFlight();
+	sInstance->mCulling = culling;
 
 	sInstance->CreateInstance();
 	sInstance->CreateSurface();
 	sInstance->PickPhysicalDevice();
 	sInstance->CreateLogicalDevice();
+	sInstance->CreateTimelineSemaphore();
+	sInstance->CreatePipelineCache();
 	sInstance->CreateSwapChain();
 	sInstance->CreateSwapChainImageViews();
 	sInstance->CreateRenderPass();
 	sInstance->CreateDescriptorSetLayouts();
-	sInstance->CreateGraphicsPipeline();
-	sInstance->CreateCommandPool();
+	sInstance->CreatePipelineLayout();
+	sInstance->CreateCullPipeline();
+	sInstance->CreateUploadCommandPool();
 	sInstance->CreateVertexBuffer();
 	sInstance->CreateIndexBuffer();
 	sInstance->CreateDepthResources();
 	sInstance->CreateFramebuffers();
-	sInstance->CreateCommandBuffers();
 	sInstance->CreateTextureSampler();
-	sInstance->CreateUniformBuffers();
+	sInstance->mRecordWorkers.Start(std::max(1u, std::thread::hardware_concurrency()));
+	sInstance->CreateFrameResources();
+	sInstance->CreateCommandBuffers();
 	sInstance->CreateDescriptorPool();
 	sInstance->CreateDescriptorSets();
+	sInstance->CreateTextureDescriptorSet();
+	sInstance->CreateMaterialTable();
 	sInstance->CreateSyncObjects();
 }
 
+void VulkanEngine::BeginFrame()
+{
+	mInputTime = std::chrono::high_resolution_clock::now();
+	mFrameBegun = true;
+
+	// Waiting here instead of in DrawFrame keeps the CPU from running ahead of the GPU with stale input
+	if (mFramePacing.mMode == FRAMEPACING_LOW_LATENCY)
+		WaitForFrame();
+}
+
+void VulkanEngine::WaitForFrame()
+{
+	if (mFrameWaited)
+		return;
+
+	WaitForTimelineValue(mFrames[mCurrentFrame].mTimelineValue);
+	ProcessDeletionQueue();
+	mFrameWaited = true;
+}
+
 void VulkanEngine::DrawFrame()
 {
 	// Sync
-	vkWaitForFences(mDevice, 1, &mInFlightFences[mCurrentFrame], VK_TRUE, UINT64_MAX);
+	if (!mFrameBegun)
+		BeginFrame();
+	WaitForFrame();
 
 	u32 imageIndex;
 	VkResult result = vkAcquireNextImageKHR(mDevice, mSwapChain, UINT64_MAX,
@@ -59,13 +94,16 @@ void VulkanEngine::DrawFrame()
 		ARC_BREAK();
 	}
 
-	if (mImagesInFlight[imageIndex] != VK_NULL_HANDLE)
-		vkWaitForFences(mDevice, 1, &mImagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
-
-	mImagesInFlight[imageIndex] = mInFlightFences[mCurrentFrame];
+	// Nothing the CPU writes is per swap chain image, so there is no need to wait for the last frame
+	// that rendered to it
 
-	UpdateUniformBuffer(imageIndex);
+	UpdateCamera();
+	UpdateLods();
+	FrameResources &frame = mFrames[mCurrentFrame];
+	UpdateUniformBuffer(frame);
+	UpdateInstanceBuffer(frame);
 	UpdateCommandBuffer(imageIndex);
+	FlushFrameResources(frame);
 
 	// Build all the required Vulkan structs...
 	VkSubmitInfo submitInfo = {};
@@ -78,15 +116,29 @@ void VulkanEngine::DrawFrame()
 	submitInfo.pWaitDstStageMask = waitStages;
 
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &mCommandBuffers[imageIndex];
+	submitInfo.pCommandBuffers = &frame.mCommandBuffer;
 
-	VkSemaphore signalSemaphores[] = { mRenderFinishedSemaphores[mCurrentFrame] };
-	submitInfo.signalSemaphoreCount = 1;
+	// Presentation needs a binary semaphore, the timeline tells the CPU when the frame is done
+	VkSemaphore signalSemaphores[] = { mRenderFinishedSemaphores[mCurrentFrame], mTimelineSemaphore };
+	submitInfo.signalSemaphoreCount = 2;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
+	frame.mTimelineValue = ++mTimelineValue;
+	const u64 waitValues[] = { 0 };
+	const u64 signalValues[] = { 0, frame.mTimelineValue };
+
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineInfo.waitSemaphoreValueCount = 1;
+	timelineInfo.pWaitSemaphoreValues = waitValues;
+	timelineInfo.signalSemaphoreValueCount = 2;
+	timelineInfo.pSignalSemaphoreValues = signalValues;
+	submitInfo.pNext = &timelineInfo;
+
 	// Submit
-	vkResetFences(mDevice, 1, &mInFlightFences[mCurrentFrame]);
-	VK_ASSERT(vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, mInFlightFences[mCurrentFrame]));
+	VK_ASSERT(vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
+	mFrameBegun = false;
+	mFrameWaited = false;
 
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -100,18 +152,24 @@ void VulkanEngine::DrawFrame()
 	presentInfo.pResults = nullptr;
 
 	result = vkQueuePresentKHR(mPresentQueue, &presentInfo);
+
+	const f32 latencyMs = std::chrono::duration<f32, std::milli>(std::chrono::high_resolution_clock::now() -
+			mInputTime).count();
+	mInputLatencyMs = mInputLatencyMs == 0.0f ? latencyMs : mInputLatencyMs * 0.9f + latencyMs * 0.1f;
+	mFrameStats.mInputLatencyMs = mInputLatencyMs;
+
+	// The frame has been submitted either way, and swap chain objects it uses are retired with it
+	mCurrentFrame = (mCurrentFrame + 1) % mFramesInFlight;
+
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || mFramebufferResized)
 	{
 		mFramebufferResized = false;
 		RecreateSwapChain();
-		return;
 	}
 	else if (result != VK_SUCCESS)
 	{
 		ARC_BREAK();
 	}
-
-	mCurrentFrame = (mCurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
 void VulkanEngine::WaitForDevice()
@@ -121,33 +179,54 @@ void VulkanEngine::WaitForDevice()
 
 void VulkanEngine::CleanUp()
 {
-	CleanUpSwapChain();
+	// The device is idle by now, so everything queued goes right away
+	RetireSwapChain();
+	ProcessDeletionQueue();
+	ARC_ASSERT(mDeletionQueue.empty());
+
+	for (auto &pipeline : mGraphicsPipelines)
+		vkDestroyPipeline(mDevice, pipeline.second, nullptr);
+	mGraphicsPipelines.clear();
+	vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+	vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
+
+	mRecordWorkers.Stop();
+	DestroyFrameResources();
+	vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
 
 	vkDestroySampler(mDevice, mTextureSampler, nullptr);
-	for (u32 i = 0; i < mTextureImages.size(); ++i)
+	for (const Texture &texture : mTextures)
 	{
-		vkDestroyImageView(mDevice, mTextureImageViews[i], nullptr);
-		vkDestroyImage(mDevice, mTextureImages[i], nullptr);
-		vkFreeMemory(mDevice, mTextureImageMemories[i], nullptr);
+		if (texture.mImage == VK_NULL_HANDLE)
+			continue;
+		vkDestroyImageView(mDevice, texture.mImageView, nullptr);
+		vkDestroyImage(mDevice, texture.mImage, nullptr);
+		vkFreeMemory(mDevice, texture.mMemory, nullptr);
 	}
+	vkDestroyDescriptorPool(mDevice, mTextureDescriptorPool, nullptr);
+	DestroyMappedBuffer(mMaterialBuffer);
 
 	vkDestroyDescriptorSetLayout(mDevice, mSceneDescriptorSetLayout, nullptr);
 	vkDestroyDescriptorSetLayout(mDevice, mFrameDescriptorSetLayout, nullptr);
 	vkDestroyDescriptorSetLayout(mDevice, mDrawDescriptorSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(mDevice, mTextureDescriptorSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(mDevice, mCullDescriptorSetLayout, nullptr);
+
+	vkDestroyPipeline(mDevice, mCullPipeline, nullptr);
+	vkDestroyPipelineLayout(mDevice, mCullPipelineLayout, nullptr);
+
+	SavePipelineCache();
+	vkDestroyPipelineCache(mDevice, mPipelineCache, nullptr);
 
 	vkDestroyBuffer(mDevice, mVertexBuffer, nullptr);
 	vkFreeMemory(mDevice, mVertexBufferMemory, nullptr);
 	vkDestroyBuffer(mDevice, mIndexBuffer, nullptr);
 	vkFreeMemory(mDevice, mIndexBufferMemory, nullptr);
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
-	{
-		vkDestroySemaphore(mDevice, mRenderFinishedSemaphores[i], nullptr);
-		vkDestroySemaphore(mDevice, mImageAvailableSemaphores[i], nullptr);
-		vkDestroyFence(mDevice, mInFlightFences[i], nullptr);
-	}
+	DestroySyncObjects();
+	vkDestroySemaphore(mDevice, mTimelineSemaphore, nullptr);
 
-	vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
+	vkDestroyCommandPool(mDevice, mUploadCommandPool, nullptr);
 	vkDestroyDevice(mDevice, nullptr);
 	vkDestroySurfaceKHR(mInstance, mSurface, nullptr);
 	vkDestroyInstance(mInstance, nullptr);
@@ -178,7 +257,8 @@ void VulkanEngine::CreateInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	// 1.1 for vkGetPhysicalDeviceFeatures2, to query descriptor indexing support
+	appInfo.apiVersion = VK_API_VERSION_1_1;
 	createInfo.pApplicationInfo = &appInfo;
 
 	u32 glfwExtensionCount = 0;
@@ -241,6 +321,12 @@ bool VulkanEngine::IsDeviceSuitable(VkPhysicalDevice device)
 	if (!indices.IsComplete())
 		return false;
 
+	// The feature and property queries below are core in 1.1, a 1.0 device can't answer them
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_1)
+		return false;
+
 	// Check features
 	VkPhysicalDeviceFeatures supportedFeatures;
 	vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
@@ -248,7 +334,57 @@ bool VulkanEngine::IsDeviceSuitable(VkPhysicalDevice device)
 	if (!supportedFeatures.samplerAnisotropy)
 		return false;
 
-	return true;
+	// Indirect draws pass their draw index through firstInstance
+	if (!supportedFeatures.drawIndirectFirstInstance)
+		return false;
+
+	// Materials pick their texture from the table, the index is the same for a whole draw
+	if (!supportedFeatures.shaderSampledImageArrayDynamicIndexing)
+		return false;
+
+	return CheckDescriptorIndexingSupport(device) && CheckTimelineSemaphoreSupport(device);
+}
+
+bool VulkanEngine::CheckTimelineSemaphoreSupport(VkPhysicalDevice device)
+{
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &timelineFeatures;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
+bool VulkanEngine::CheckDescriptorIndexingSupport(VkPhysicalDevice device)
+{
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &indexingFeatures;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	// Slots are left empty until a texture is loaded in them, and written while frames that don't
+	// use them are in flight
+	if (!indexingFeatures.descriptorBindingPartiallyBound ||
+			!indexingFeatures.descriptorBindingSampledImageUpdateAfterBind ||
+			!indexingFeatures.descriptorBindingUpdateUnusedWhilePending)
+		return false;
+
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &indexingProperties;
+	vkGetPhysicalDeviceProperties2(device, &properties);
+
+	return indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages >= MAX_TEXTURES &&
+			indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages >= MAX_TEXTURES;
 }
 
 bool VulkanEngine::CheckDeviceExtensionSupport(VkPhysicalDevice device)
@@ -278,7 +414,8 @@ VulkanEngine::QueueFamilyIndices VulkanEngine::FindQueueFamilies(VkPhysicalDevic
 	int i = 0;
 	for (const auto &queueFamily : queueFamilies)
 	{
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		// Culling runs on the graphics queue
+		if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
 		{
 			indices.graphicsFamily = i;
 		}
@@ -320,11 +457,34 @@ void VulkanEngine::CreateLogicalDevice()
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+	mNonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
+
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(mPhysicalDevice, &supportedFeatures);
+	mSupportsMultiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+	indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+	indexingFeatures.pNext = &timelineFeatures;
 
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &indexingFeatures;
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = static_cast<u32>(queueCreateInfos.size());
 	createInfo.pEnabledFeatures = &deviceFeatures;
@@ -346,6 +506,12 @@ void VulkanEngine::CreateLogicalDevice()
 	// Retrieve queues
 	vkGetDeviceQueue(mDevice, indices.graphicsFamily.value(), 0, &mGraphicsQueue);
 	vkGetDeviceQueue(mDevice, indices.presentFamily.value(), 0, &mPresentQueue);
+
+	// Extension entry points aren't exported by the loader
+	mWaitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(mDevice, "vkWaitSemaphoresKHR"));
+	mGetSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+			vkGetDeviceProcAddr(mDevice, "vkGetSemaphoreCounterValueKHR"));
+	ARC_ASSERT(mWaitSemaphores && mGetSemaphoreCounterValue);
 }
 
 VulkanEngine::SwapChainSupportDetails VulkanEngine::QuerySwapChainSupport(VkPhysicalDevice device)
@@ -382,7 +548,8 @@ void VulkanEngine::CreateSwapChain()
 	VkPresentModeKHR presentMode = ChooseSwapPresentMode(swapChainSupport.presentModes);
 	VkExtent2D extent = ChooseSwapExtent(swapChainSupport.capabilities);
 
-	u32 imageCount = swapChainSupport.capabilities.minImageCount + 1;
+	// Enough images for every frame in flight plus the one being displayed
+	u32 imageCount = std::max(swapChainSupport.capabilities.minImageCount + 1, mFramesInFlight + 1);
 	const u32 maxImageCount = swapChainSupport.capabilities.maxImageCount;
 	if (maxImageCount > 0 && imageCount > maxImageCount)
 		imageCount = maxImageCount;
@@ -416,7 +583,8 @@ void VulkanEngine::CreateSwapChain()
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	// Lets the driver hand resources over, the old one is retired by the caller
+	createInfo.oldSwapchain = mSwapChain;
 
 	VK_ASSERT(vkCreateSwapchainKHR(mDevice, &createInfo, nullptr, &mSwapChain));
 
@@ -439,20 +607,97 @@ void VulkanEngine::RecreateSwapChain()
 		glfwWaitEvents();
 	}
 
-	// Wait until resources are not in use
-	vkDeviceWaitIdle(mDevice);
-
-	CleanUpSwapChain();
+	// Frames in flight may still render to the old images, so they are destroyed once those are done
+	// instead of waiting for the device to go idle. Pipelines and descriptors don't depend on the size.
+	const VkFormat oldFormat = mSwapChainImageFormat;
+	RetireSwapChain();
 
 	CreateSwapChain();
 	CreateSwapChainImageViews();
-	CreateRenderPass();
-	CreateGraphicsPipeline();
+	if (mSwapChainImageFormat != oldFormat)
+	{
+		// Rare enough (moving to a display with another format) to rebuild whatever depends on it
+		for (auto &pipeline : mGraphicsPipelines)
+			DeferDestroy(DEFERRED_PIPELINE, pipeline.second);
+		mGraphicsPipelines.clear();
+		DeferDestroy(DEFERRED_RENDER_PASS, mRenderPass);
+		CreateRenderPass();
+		for (FrameResources &frame : mFrames)
+			frame.mDrawsRecorded = false;
+	}
 	CreateDepthResources();
 	CreateFramebuffers();
-	CreateUniformBuffers();
-	CreateDescriptorPool();
-	CreateDescriptorSets();
+
+}
+
+void VulkanEngine::RetireSwapChain()
+{
+	for (VkFramebuffer framebuffer : mSwapChainFramebuffers)
+		DeferDestroy(DEFERRED_FRAMEBUFFER, framebuffer);
+	for (VkImageView imageView : mSwapChainImageViews)
+		DeferDestroy(DEFERRED_IMAGE_VIEW, imageView);
+	mSwapChainFramebuffers.clear();
+	mSwapChainImageViews.clear();
+
+	DeferDestroy(DEFERRED_IMAGE_VIEW, mDepthImageView);
+	DeferDestroy(DEFERRED_IMAGE, mDepthImage);
+	DeferDestroy(DEFERRED_MEMORY, mDepthImageMemory);
+
+	// Still passed as the old swap chain when creating the next one
+	DeferDestroy(DEFERRED_SWAPCHAIN, mSwapChain);
+}
+
+void VulkanEngine::DeferFreeSlot(u8 type, u32 slot)
+{
+	mDeletionQueue.push_back({ mTimelineValue, slot, type });
+}
+
+void VulkanEngine::ProcessDeletionQueue()
+{
+	if (mDeletionQueue.empty())
+		return;
+
+	// Queued in submission order, so stop at the first one still in use
+	const u64 completedValue = GetCompletedTimelineValue();
+	u32 count = 0;
+	for (; count < mDeletionQueue.size(); ++count)
+	{
+		const DeferredDestroy &entry = mDeletionQueue[count];
+		if (entry.mTimelineValue > completedValue)
+			break;
+
+		switch (entry.mType)
+		{
+			case DEFERRED_MEMORY:
+				vkFreeMemory(mDevice, reinterpret_cast<VkDeviceMemory>(entry.mHandle), nullptr);
+				break;
+			case DEFERRED_IMAGE:
+				vkDestroyImage(mDevice, reinterpret_cast<VkImage>(entry.mHandle), nullptr);
+				break;
+			case DEFERRED_IMAGE_VIEW:
+				vkDestroyImageView(mDevice, reinterpret_cast<VkImageView>(entry.mHandle), nullptr);
+				break;
+			case DEFERRED_FRAMEBUFFER:
+				vkDestroyFramebuffer(mDevice, reinterpret_cast<VkFramebuffer>(entry.mHandle), nullptr);
+				break;
+			case DEFERRED_PIPELINE:
+				vkDestroyPipeline(mDevice, reinterpret_cast<VkPipeline>(entry.mHandle), nullptr);
+				break;
+			case DEFERRED_RENDER_PASS:
+				vkDestroyRenderPass(mDevice, reinterpret_cast<VkRenderPass>(entry.mHandle), nullptr);
+				break;
+			case DEFERRED_SWAPCHAIN:
+				vkDestroySwapchainKHR(mDevice, reinterpret_cast<VkSwapchainKHR>(entry.mHandle), nullptr);
+				break;
+			case DEFERRED_TEXTURE_SLOT:
+				mFreeTextureSlots.push_back(static_cast<u32>(entry.mHandle));
+				break;
+			case DEFERRED_MATERIAL_SLOT:
+				mFreeMaterialSlots.push_back(static_cast<u32>(entry.mHandle));
+				break;
+		}
+	}
+	mDeletionQueue.erase(mDeletionQueue.begin(), mDeletionQueue.begin() + count);
 }
 
 VkSurfaceFormatKHR VulkanEngine::ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>
@@ -472,10 +717,20 @@ VkSurfaceFormatKHR VulkanEngine::ChooseSwapSurfaceFormat(const std::vector<VkSur
 VkPresentModeKHR VulkanEngine::ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>
 		&availablePresentModes)
 {
-	for (const auto &availablePresentMode : availablePresentModes)
+	// Low latency prefers mailbox, which never tears, throughput immediate, which never waits for
+	// vblank. FIFO is the only mode that is always supported.
+	const VkPresentModeKHR lowLatencyModes[] = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+	const VkPresentModeKHR throughputModes[] = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR };
+	const VkPresentModeKHR *preferredModes = mFramePacing.mMode == FRAMEPACING_LOW_LATENCY ? lowLatencyModes :
+			throughputModes;
+
+	for (u32 i = 0; i < 2; ++i)
 	{
-		if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
-			return availablePresentMode;
+		for (const auto &availablePresentMode : availablePresentModes)
+		{
+			if (availablePresentMode == preferredModes[i])
+				return availablePresentMode;
+		}
 	}
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
@@ -596,41 +851,246 @@ void VulkanEngine::CreateDescriptorSetLayouts()
 
 	// Draw
 	{
-		VkDescriptorSetLayoutBinding uniformLayoutBinding = {};
-		uniformLayoutBinding.binding = 0;
-		uniformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-		uniformLayoutBinding.descriptorCount = 1;
-		uniformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		uniformLayoutBinding.pImmutableSamplers = nullptr;
+		VkDescriptorSetLayoutBinding instanceLayoutBinding = {};
+		instanceLayoutBinding.binding = 0;
+		instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		instanceLayoutBinding.descriptorCount = 1;
+		instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		instanceLayoutBinding.pImmutableSamplers = nullptr;
+
+		VkDescriptorSetLayoutBinding instanceIndexLayoutBinding = {};
+		instanceIndexLayoutBinding.binding = 1;
+		instanceIndexLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		instanceIndexLayoutBinding.descriptorCount = 1;
+		instanceIndexLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		instanceIndexLayoutBinding.pImmutableSamplers = nullptr;
+
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings =
+		{
+			instanceLayoutBinding, instanceIndexLayoutBinding
+		};
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<u32>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		VK_ASSERT(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mDrawDescriptorSetLayout));
+	}
 
+	// Textures and materials: sampler, texture table and material table
+	{
 		VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-		samplerLayoutBinding.binding = 1;
+		samplerLayoutBinding.binding = 0;
 		samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
 		samplerLayoutBinding.descriptorCount = 1;
 		samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 		samplerLayoutBinding.pImmutableSamplers = nullptr;
 
 		VkDescriptorSetLayoutBinding imageLayoutBinding = {};
-		imageLayoutBinding.binding = 2;
+		imageLayoutBinding.binding = 1;
 		imageLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-		imageLayoutBinding.descriptorCount = 4;
+		imageLayoutBinding.descriptorCount = MAX_TEXTURES;
 		imageLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 		imageLayoutBinding.pImmutableSamplers = nullptr;
 
+		VkDescriptorSetLayoutBinding materialLayoutBinding = {};
+		materialLayoutBinding.binding = 2;
+		materialLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		materialLayoutBinding.descriptorCount = 1;
+		materialLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		materialLayoutBinding.pImmutableSamplers = nullptr;
+
 		std::array<VkDescriptorSetLayoutBinding, 3> bindings =
 		{
-			uniformLayoutBinding, imageLayoutBinding, samplerLayoutBinding
+			samplerLayoutBinding, imageLayoutBinding, materialLayoutBinding
+		};
+		// Only the slots drawn with need to be valid, and free ones can be written while in use
+		const std::array<VkDescriptorBindingFlagsEXT, 3> bindingFlags =
+		{
+			0u,
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+					VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT,
+			0u
 		};
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		bindingFlagsInfo.bindingCount = static_cast<u32>(bindingFlags.size());
+		bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
 		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
 		layoutInfo.bindingCount = static_cast<u32>(bindings.size());
 		layoutInfo.pBindings = bindings.data();
 
-		VK_ASSERT(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mDrawDescriptorSetLayout));
+		VK_ASSERT(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mTextureDescriptorSetLayout));
+	}
+
+	// Culling: objects, indirect commands, stats and visible instances
+	{
+		std::array<VkDescriptorSetLayoutBinding, 4> bindings = {};
+		for (u32 i = 0; i < bindings.size(); ++i)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[i].pImmutableSamplers = nullptr;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<u32>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		VK_ASSERT(vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mCullDescriptorSetLayout));
+	}
+}
+
+void VulkanEngine::CreatePipelineCache()
+{
+	// A missing or stale cache is not an error, the pipelines are just compiled from scratch
+	std::vector<char> data;
+	std::ifstream file(PIPELINE_CACHE_PATH, std::ios::ate | std::ios::binary);
+	if (file.is_open())
+	{
+		data.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(data.data(), data.size());
+		if (!file || !IsPipelineCacheCompatible(data))
+			data.clear();
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo = {};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	VK_ASSERT(vkCreatePipelineCache(mDevice, &cacheInfo, nullptr, &mPipelineCache));
+}
+
+bool VulkanEngine::IsPipelineCacheCompatible(const std::vector<char> &data)
+{
+	// Drivers should reject caches from other devices themselves, but not all of them do
+	struct PipelineCacheHeader
+	{
+		u32 headerSize;
+		u32 headerVersion;
+		u32 vendorID;
+		u32 deviceID;
+		u8 pipelineCacheUUID[VK_UUID_SIZE];
+	};
+
+	PipelineCacheHeader header;
+	if (data.size() < sizeof(header))
+		return false;
+	memcpy(&header, data.data(), sizeof(header));
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
+
+	return header.headerSize >= sizeof(header) && header.headerSize <= data.size() &&
+			header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+			memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void VulkanEngine::SavePipelineCache()
+{
+	size_t dataSize = 0;
+	VK_ASSERT(vkGetPipelineCacheData(mDevice, mPipelineCache, &dataSize, nullptr));
+	std::vector<char> data(dataSize);
+	VK_ASSERT(vkGetPipelineCacheData(mDevice, mPipelineCache, &dataSize, data.data()));
+
+	// Written next to the old one and renamed over it, so a crash halfway never leaves a truncated cache
+	const std::string tempPath = PIPELINE_CACHE_PATH + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return;
+		file.write(data.data(), dataSize);
+		if (!file)
+			return;
 	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, PIPELINE_CACHE_PATH, error);
+	if (error)
+		std::filesystem::remove(tempPath, error);
+}
+
+void VulkanEngine::CreatePipelineLayout()
+{
+	const VkDescriptorSetLayout setLayouts[] = {
+		mSceneDescriptorSetLayout,
+		mFrameDescriptorSetLayout,
+		mDrawDescriptorSetLayout,
+		mTextureDescriptorSetLayout
+	};
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = DS_COUNT;
+	pipelineLayoutInfo.pSetLayouts = setLayouts;
+	pipelineLayoutInfo.pushConstantRangeCount = 0;
+	pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+	VK_ASSERT(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mPipelineLayout));
+}
+
+void VulkanEngine::CreateCullPipeline()
+{
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(CullPushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &mCullDescriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	VK_ASSERT(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mCullPipelineLayout));
+
+	std::vector<char> compShaderCode = ReadFile("shaders/cull.spv");
+	VkShaderModule compShaderModule = CreateShaderModule(compShaderCode);
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = compShaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = mCullPipelineLayout;
+
+	VK_ASSERT(vkCreateComputePipelines(mDevice, mPipelineCache, 1, &pipelineInfo, nullptr, &mCullPipeline));
+
+	vkDestroyShaderModule(mDevice, compShaderModule, nullptr);
+}
+
+u32 VulkanEngine::GetGraphicsPipelineKey(const VertexLayout &vertexLayout, u32 materialFeatures)
+{
+	// Vertex layout keys only use the low 24 bits
+	return vertexLayout.GetKey() | (materialFeatures << 24);
+}
+
+VkPipeline VulkanEngine::GetGraphicsPipeline(const VertexLayout &vertexLayout, u32 materialFeatures)
+{
+	const u32 key = GetGraphicsPipelineKey(vertexLayout, materialFeatures);
+	auto it = mGraphicsPipelines.find(key);
+	if (it != mGraphicsPipelines.end())
+		return it->second;
+
+	const VkPipeline pipeline = CreateGraphicsPipeline(vertexLayout, materialFeatures);
+	mGraphicsPipelines[key] = pipeline;
+	return pipeline;
 }
 
-void VulkanEngine::CreateGraphicsPipeline()
+VkPipeline VulkanEngine::CreateGraphicsPipeline(const VertexLayout &vertexLayout, u32 materialFeatures)
 {
 	std::vector<char> vertShaderCode = ReadFile("shaders/vert.spv");
 	std::vector<char> fragShaderCode = ReadFile("shaders/frag.spv");
@@ -650,15 +1110,33 @@ void VulkanEngine::CreateGraphicsPipeline()
 	fragShaderStageInfo.module = fragShaderModule;
 	fragShaderStageInfo.pName = "main";
 
+	// Features the material doesn't use are constant false, so the driver compiles them out
+	std::array<VkBool32, MATERIAL_FEATURE_COUNT> featureConstants;
+	std::array<VkSpecializationMapEntry, MATERIAL_FEATURE_COUNT> specializationEntries;
+	for (u32 i = 0; i < MATERIAL_FEATURE_COUNT; ++i)
+	{
+		featureConstants[i] = (materialFeatures >> i) & 1;
+		specializationEntries[i].constantID = i;
+		specializationEntries[i].offset = i * sizeof(VkBool32);
+		specializationEntries[i].size = sizeof(VkBool32);
+	}
+
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = static_cast<u32>(specializationEntries.size());
+	specializationInfo.pMapEntries = specializationEntries.data();
+	specializationInfo.dataSize = sizeof(featureConstants);
+	specializationInfo.pData = featureConstants.data();
+	fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-	auto bindingDescription = Vertex::GetBindingDescription();
-	auto attributeDescriptions = Vertex::GetAttributeDescriptions();
+	auto bindingDescriptions = vertexLayout.GetBindingDescriptions();
+	auto attributeDescriptions = vertexLayout.GetAttributeDescriptions();
 
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<u32>(bindingDescriptions.size());
+	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
 	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<u32>(attributeDescriptions.size());
 	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
@@ -667,24 +1145,19 @@ void VulkanEngine::CreateGraphicsPipeline()
 	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-	VkViewport viewport = {};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(mSwapChainExtent.width);
-	viewport.height = static_cast<float>(mSwapChainExtent.height);
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor = {};
-	scissor.offset = { 0, 0 };
-	scissor.extent = mSwapChainExtent;
-
+	// Viewport and scissor are dynamic, so pipelines survive a resize
 	VkPipelineViewportStateCreateInfo viewportState = {};
 	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
+	viewportState.pViewports = nullptr;
 	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
+	viewportState.pScissors = nullptr;
+
+	const VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
 
 	VkPipelineRasterizationStateCreateInfo rasterizer = {};
 	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -734,25 +1207,6 @@ void VulkanEngine::CreateGraphicsPipeline()
 	colorBlending.blendConstants[2] = 0.0f;
 	colorBlending.blendConstants[3] = 0.0f;
 
-	const VkDescriptorSetLayout setLayouts[] = {
-		mSceneDescriptorSetLayout,
-		mFrameDescriptorSetLayout,
-		mDrawDescriptorSetLayout
-	};
-	VkPushConstantRange pushConstantRange = {};
-	pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-	pushConstantRange.offset = 0;
-	pushConstantRange.size = sizeof(u32);
-
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = DS_COUNT;
-	pipelineLayoutInfo.pSetLayouts = setLayouts;
-	pipelineLayoutInfo.pushConstantRangeCount = 1;
-	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-
-	VK_ASSERT(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mPipelineLayout));
-
 	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
 	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 	depthStencil.depthTestEnable = VK_TRUE;
@@ -772,7 +1226,7 @@ void VulkanEngine::CreateGraphicsPipeline()
 	pipelineInfo.pMultisampleState = &multisampling;
 	pipelineInfo.pDepthStencilState = &depthStencil;
 	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = nullptr;
+	pipelineInfo.pDynamicState = &dynamicState;
 
 	pipelineInfo.layout = mPipelineLayout;
 	pipelineInfo.renderPass = mRenderPass;
@@ -781,11 +1235,13 @@ void VulkanEngine::CreateGraphicsPipeline()
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.basePipelineIndex = -1;
 
-	VK_ASSERT(vkCreateGraphicsPipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
-			&mGraphicsPipeline));
+	VkPipeline pipeline;
+	VK_ASSERT(vkCreateGraphicsPipelines(mDevice, mPipelineCache, 1, &pipelineInfo, nullptr, &pipeline));
 
 	vkDestroyShaderModule(mDevice, vertShaderModule, nullptr);
 	vkDestroyShaderModule(mDevice, fragShaderModule, nullptr);
+
+	return pipeline;
 }
 
 VkShaderModule VulkanEngine::CreateShaderModule(const std::vector<char> &code)
@@ -824,16 +1280,32 @@ void VulkanEngine::CreateFramebuffers()
 	}
 }
 
-void VulkanEngine::CreateCommandPool()
+VkCommandPool VulkanEngine::CreateTransientCommandPool()
 {
 	QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(mPhysicalDevice);
 
+	// Buffers are never reset one by one, the whole pool is once the GPU is done with them
 	VkCommandPoolCreateInfo poolInfo = {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	VkCommandPool pool;
+	VK_ASSERT(vkCreateCommandPool(mDevice, &poolInfo, nullptr, &pool));
+	return pool;
+}
+
+void VulkanEngine::CreateUploadCommandPool()
+{
+	mUploadCommandPool = CreateTransientCommandPool();
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = mUploadCommandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
 
-	VK_ASSERT(vkCreateCommandPool(mDevice, &poolInfo, nullptr, &mCommandPool));
+	VK_ASSERT(vkAllocateCommandBuffers(mDevice, &allocInfo, &mUploadCommandBuffer));
 }
 
 void VulkanEngine::CreateBuffer(
@@ -913,7 +1385,7 @@ bool VulkanEngine::HasStencilComponent(VkFormat format)
 	return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
-void VulkanEngine::LoadTextureFromImage(void *pixels, u32 width, u32 height)
+u32 VulkanEngine::LoadTextureFromImage(void *pixels, u32 width, u32 height)
 {
 	const VkDeviceSize imageSize = width * height * 4;
 
@@ -934,12 +1406,6 @@ void VulkanEngine::LoadTextureFromImage(void *pixels, u32 width, u32 height)
 	CreateTextureImage(width, height, image, imageMemory);
 	CreateTextureImageView(image, imageView);
 
-	mTextureImages.push_back(image);
-	mTextureImageViews.push_back(imageView);
-	mTextureImageMemories.push_back(imageMemory);
-
-	//UpdateDescriptorSets();
-
 	TransitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 	CopyBufferToImage(stagingBuffer, image, static_cast<u32>(width), static_cast<u32>(height));
@@ -949,6 +1415,58 @@ void VulkanEngine::LoadTextureFromImage(void *pixels, u32 width, u32 height)
 
 	vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
 	vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
+
+	u32 slot;
+	if (!mFreeTextureSlots.empty())
+	{
+		slot = mFreeTextureSlots.back();
+		mFreeTextureSlots.pop_back();
+	}
+	else
+	{
+		slot = static_cast<u32>(mTextures.size());
+		ARC_ASSERT(slot < MAX_TEXTURES);
+		mTextures.emplace_back();
+	}
+	mTextures[slot] = Texture { image, imageMemory, imageView };
+
+	// Nothing in flight draws with a free slot, so it can be written right away
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = imageView;
+	imageInfo.sampler = VK_NULL_HANDLE;
+
+	VkWriteDescriptorSet descriptorWrite = {};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = mTextureDescriptorSet;
+	descriptorWrite.dstBinding = 1;
+	descriptorWrite.dstArrayElement = slot;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &imageInfo;
+	vkUpdateDescriptorSets(mDevice, 1, &descriptorWrite, 0, nullptr);
+
+	return slot;
+}
+
+void VulkanEngine::UnloadTexture(u32 slot)
+{
+	Texture &texture = mTextures[slot];
+	ARC_ASSERT(texture.mImage != VK_NULL_HANDLE);
+
+	// Destroyed materials are cleared, one still using the slot would sample whatever is loaded in it next
+	for (const Material &material : mMaterials)
+		ARC_ASSERT(!(material.mFeatures & MATERIALFEATURE_TEXTURE) || material.mTextureSlot != slot);
+
+	// The image may still be sampled by frames in flight, and the slot can't be rewritten before
+	// they're done either
+	DeferDestroy(DEFERRED_IMAGE_VIEW, texture.mImageView);
+	DeferDestroy(DEFERRED_IMAGE, texture.mImage);
+	DeferDestroy(DEFERRED_MEMORY, texture.mMemory);
+	texture = Texture {};
+
+	// The descriptor is left dangling, partially bound slots aren't accessed unless drawn with
+	DeferFreeSlot(DEFERRED_TEXTURE_SLOT, slot);
 }
 
 void VulkanEngine::CreateTextureImage(u32 width, u32 height, VkImage &image, VkDeviceMemory &imageMemory)
@@ -996,21 +1514,13 @@ void VulkanEngine::CreateImage(u32 width, u32 height, VkFormat format, VkImageTi
 
 VkCommandBuffer VulkanEngine::BeginSingleTimeCommands()
 {
-	VkCommandBufferAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = mCommandPool;
-	allocInfo.commandBufferCount = 1;
-
-	VkCommandBuffer commandBuffer = {};
-	vkAllocateCommandBuffers(mDevice, &allocInfo, &commandBuffer);
-
+	// Every upload waits for its submission, so the one buffer is always free by the next one
 	VkCommandBufferBeginInfo beginInfo = {};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
-	return commandBuffer;
+	vkBeginCommandBuffer(mUploadCommandBuffer, &beginInfo);
+	return mUploadCommandBuffer;
 }
 
 void VulkanEngine::EndSingleTimeCommands(VkCommandBuffer commandBuffer)
@@ -1022,10 +1532,20 @@ void VulkanEngine::EndSingleTimeCommands(VkCommandBuffer commandBuffer)
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
+	// Only waits for this submission, not for frames in flight that were submitted before it
+	const u64 signalValue = ++mTimelineValue;
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &mTimelineSemaphore;
+
 	vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(mGraphicsQueue);
+	WaitForTimelineValue(signalValue);
 
-	vkFreeCommandBuffers(mDevice, mCommandPool, 1, &commandBuffer);
+	VK_ASSERT(vkResetCommandPool(mDevice, mUploadCommandPool, 0));
 }
 
 VkImageView VulkanEngine::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
@@ -1247,6 +1767,14 @@ void VulkanEngine::CopyBufferToImage(VkBuffer buffer, VkImage image, u32 width,
 }
 
 u32 VulkanEngine::FindMemoryType(u32 typeFilter, VkMemoryPropertyFlags properties)
+{
+	const u32 memoryType = TryFindMemoryType(typeFilter, properties);
+	if (memoryType == UINT32_MAX)
+		ARC_BREAK();
+	return memoryType;
+}
+
+u32 VulkanEngine::TryFindMemoryType(u32 typeFilter, VkMemoryPropertyFlags properties)
 {
 	VkPhysicalDeviceMemoryProperties memProperties;
 	vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice, &memProperties);
@@ -1259,87 +1787,217 @@ u32 VulkanEngine::FindMemoryType(u32 typeFilter, VkMemoryPropertyFlags propertie
 		}
 	}
 
-	ARC_BREAK();
 	return UINT32_MAX;
 }
 
-void VulkanEngine::CreateUniformBuffers()
+void VulkanEngine::CreateMappedBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MappedBuffer &buffer)
 {
-	const VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	mUniformBuffers.resize(mSwapChainImages.size());
-	mUniformBuffersMemory.resize(mSwapChainImages.size());
+	VK_ASSERT(vkCreateBuffer(mDevice, &bufferInfo, nullptr, &buffer.mBuffer));
 
-	for (size_t i = 0; i < mSwapChainImages.size(); ++i)
-	{
-		CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-				VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, mUniformBuffers[i], mUniformBuffersMemory[i]);
-	}
-}
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(mDevice, buffer.mBuffer, &memRequirements);
 
-void VulkanEngine::CreateDescriptorPool()
-{
-	std::array<VkDescriptorPoolSize, 4> poolSizes = {};
-	// Static descriptors (scene and frame)
+	// Coherent memory saves the flushes, but any host visible memory will do
+	u32 memoryType = TryFindMemoryType(memRequirements.memoryTypeBits,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	buffer.mCoherent = memoryType != UINT32_MAX;
+	if (!buffer.mCoherent)
+		memoryType = FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	VK_ASSERT(vkAllocateMemory(mDevice, &allocInfo, nullptr, &buffer.mMemory));
+
+	vkBindBufferMemory(mDevice, buffer.mBuffer, buffer.mMemory, 0);
+
+	void *data;
+	VK_ASSERT(vkMapMemory(mDevice, buffer.mMemory, 0, VK_WHOLE_SIZE, 0, &data));
+	buffer.mData = static_cast<u8 *>(data);
+	buffer.mSize = memRequirements.size;
+	buffer.mDirtyBegin = VK_WHOLE_SIZE;
+	buffer.mDirtyEnd = 0;
+}
+
+void VulkanEngine::DestroyMappedBuffer(MappedBuffer &buffer)
+{
+	vkUnmapMemory(mDevice, buffer.mMemory);
+	vkDestroyBuffer(mDevice, buffer.mBuffer, nullptr);
+	vkFreeMemory(mDevice, buffer.mMemory, nullptr);
+	buffer.mData = nullptr;
+}
+
+void VulkanEngine::FlushMappedBuffer(MappedBuffer &buffer)
+{
+	if (buffer.mDirtyBegin >= buffer.mDirtyEnd)
+		return;
+
+	if (!buffer.mCoherent)
+	{
+		// Ranges have to be aligned to the atom size, or reach the end of the allocation
+		VkMappedMemoryRange range = {};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = buffer.mMemory;
+		range.offset = buffer.mDirtyBegin / mNonCoherentAtomSize * mNonCoherentAtomSize;
+		const VkDeviceSize end = (buffer.mDirtyEnd + mNonCoherentAtomSize - 1) / mNonCoherentAtomSize *
+				mNonCoherentAtomSize;
+		range.size = end < buffer.mSize ? end - range.offset : VK_WHOLE_SIZE;
+		VK_ASSERT(vkFlushMappedMemoryRanges(mDevice, 1, &range));
+	}
+
+	buffer.mDirtyBegin = VK_WHOLE_SIZE;
+	buffer.mDirtyEnd = 0;
+}
+
+void VulkanEngine::InvalidateMappedBuffer(MappedBuffer &buffer)
+{
+	if (buffer.mCoherent)
+		return;
+
+	VkMappedMemoryRange range = {};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = buffer.mMemory;
+	range.offset = 0;
+	range.size = VK_WHOLE_SIZE;
+	VK_ASSERT(vkInvalidateMappedMemoryRanges(mDevice, 1, &range));
+}
+
+void VulkanEngine::CreateFrameResources()
+{
+	mFrames.resize(mFramesInFlight);
+	for (FrameResources &frame : mFrames)
+	{
+		CreateMappedBuffer(sizeof(UniformBufferObject), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, frame.mUniformBuffer);
+
+		AllocateInstanceBuffers(frame, INITIAL_INSTANCE_CAPACITY);
+
+		CreateMappedBuffer(sizeof(CullStats), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				frame.mCullStatsBuffer);
+		// Nothing has been culled yet when the stats are first read back
+		memset(frame.mCullStatsBuffer.mData, 0, sizeof(CullStats));
+		frame.mCullStatsBuffer.MarkDirty(0, sizeof(CullStats));
+		FlushMappedBuffer(frame.mCullStatsBuffer);
+	}
+}
+
+void VulkanEngine::DestroyFrameResources()
+{
+	for (FrameResources &frame : mFrames)
+	{
+		// Their command buffers go with them
+		vkDestroyCommandPool(mDevice, frame.mCommandPool, nullptr);
+		for (VkCommandPool pool : frame.mRecordCommandPools)
+			vkDestroyCommandPool(mDevice, pool, nullptr);
+		DestroyMappedBuffer(frame.mUniformBuffer);
+		FreeInstanceBuffers(frame);
+		DestroyMappedBuffer(frame.mCullStatsBuffer);
+	}
+	mFrames.clear();
+}
+
+void VulkanEngine::AllocateInstanceBuffers(FrameResources &frame, u32 capacity)
+{
+	frame.mInstanceCapacity = capacity;
+
+	CreateMappedBuffer(sizeof(InstanceData) * capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, frame.mInstanceBuffer);
+	// Visible instances of each draw, written by the CPU or the culling shader
+	CreateMappedBuffer(sizeof(u32) * capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, frame.mInstanceIndexBuffer);
+
+	CreateMappedBuffer(sizeof(CullObject) * capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, frame.mCullObjectBuffer);
+	// One command per draw group at most. Written by the CPU with every instance of the group, the
+	// culling shader leaves only the visible ones.
+	CreateMappedBuffer(sizeof(VkDrawIndexedIndirectCommand) * capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, frame.mIndirectBuffer);
+}
+
+void VulkanEngine::FreeInstanceBuffers(FrameResources &frame)
+{
+	DestroyMappedBuffer(frame.mInstanceBuffer);
+	DestroyMappedBuffer(frame.mInstanceIndexBuffer);
+	DestroyMappedBuffer(frame.mCullObjectBuffer);
+	DestroyMappedBuffer(frame.mIndirectBuffer);
+}
+
+void VulkanEngine::ReserveInstances(FrameResources &frame, u32 instanceCount)
+{
+	if (instanceCount <= frame.mInstanceCapacity)
+		return;
+
+	u32 capacity = frame.mInstanceCapacity;
+	while (capacity < instanceCount)
+		capacity *= 2;
+
+	// The frame's timeline value has been reached, so nothing in flight uses its buffers or descriptor sets
+	FreeInstanceBuffers(frame);
+	AllocateInstanceBuffers(frame, capacity);
+	WriteInstanceDescriptorSets(frame);
+}
+
+void VulkanEngine::CreateDescriptorPool()
+{
+	const u32 frameCount = static_cast<u32>(mFrames.size());
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+	// Scene and frame
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[0].descriptorCount = static_cast<u32>(mSwapChainImages.size() * 2);
-	// Dynamic descriptors (draw)
-	poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-	poolSizes[1].descriptorCount = static_cast<u32>(mSwapChainImages.size());
-	poolSizes[2].type = VK_DESCRIPTOR_TYPE_SAMPLER;
-	poolSizes[2].descriptorCount = static_cast<u32>(mSwapChainImages.size());
-	poolSizes[3].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-	poolSizes[3].descriptorCount = static_cast<u32>(mSwapChainImages.size() * 4);
+	poolSizes[0].descriptorCount = frameCount * 2;
+	// Instances and visible instances for drawing, plus the 4 culling buffers
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = frameCount * 6;
 
 	VkDescriptorPoolCreateInfo poolInfo = {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolInfo.poolSizeCount = static_cast<u32>(poolSizes.size());
 	poolInfo.pPoolSizes = poolSizes.data();
-	poolInfo.maxSets = static_cast<u32>(mSwapChainImages.size() * DS_COUNT);
+	// Scene, frame, draw and cull sets
+	poolInfo.maxSets = frameCount * 4;
 
 	VK_ASSERT(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mDescriptorPool));
 }
 
 void VulkanEngine::CreateDescriptorSets()
 {
+	// Scene, frame, draw and cull sets
+	const std::array<VkDescriptorSetLayout, 4> layouts = {
+		mSceneDescriptorSetLayout, mFrameDescriptorSetLayout, mDrawDescriptorSetLayout, mCullDescriptorSetLayout
+	};
+
 	VkDescriptorSetAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocInfo.descriptorPool = mDescriptorPool;
-	allocInfo.descriptorSetCount = static_cast<u32>(mSwapChainImages.size());
+	allocInfo.descriptorSetCount = static_cast<u32>(layouts.size());
+	allocInfo.pSetLayouts = layouts.data();
 
-	// Scene descriptor set
-	std::vector<VkDescriptorSetLayout> sceneLayouts(mSwapChainImages.size(), mSceneDescriptorSetLayout);
-	allocInfo.pSetLayouts = sceneLayouts.data();
-	mSceneDescriptorSets.resize(mSwapChainImages.size());
-	VK_ASSERT(vkAllocateDescriptorSets(mDevice, &allocInfo, mSceneDescriptorSets.data()));
+	for (FrameResources &frame : mFrames)
+	{
+		std::array<VkDescriptorSet, 4> sets;
+		VK_ASSERT(vkAllocateDescriptorSets(mDevice, &allocInfo, sets.data()));
+		frame.mSceneDescriptorSet = sets[0];
+		frame.mFrameDescriptorSet = sets[1];
+		frame.mDrawDescriptorSet = sets[2];
+		frame.mCullDescriptorSet = sets[3];
 
-	// Frame descriptor set
-	std::vector<VkDescriptorSetLayout> frameLayouts(mSwapChainImages.size(), mFrameDescriptorSetLayout);
-	allocInfo.pSetLayouts = frameLayouts.data();
-	mFrameDescriptorSets.resize(mSwapChainImages.size());
-	VK_ASSERT(vkAllocateDescriptorSets(mDevice, &allocInfo, mFrameDescriptorSets.data()));
+		// Buffers that only change when they grow are written right away, the uniform buffer never does
+		WriteInstanceDescriptorSets(frame);
 
-	// Draw descriptor set
-	std::vector<VkDescriptorSetLayout> drawLayouts(mSwapChainImages.size(), mDrawDescriptorSetLayout);
-	allocInfo.pSetLayouts = drawLayouts.data();
-	mDrawDescriptorSets.resize(mSwapChainImages.size());
-	VK_ASSERT(vkAllocateDescriptorSets(mDevice, &allocInfo, mDrawDescriptorSets.data()));
-}
-
-void VulkanEngine::UpdateDescriptorSets()
-{
-	for (size_t i = 0; i < mSwapChainImages.size(); ++i)
-	{
-		std::array<VkWriteDescriptorSet, 5> descriptorWrites = {};
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
 
 		// Scene descriptor
 		VkDescriptorBufferInfo sceneBufferInfo = {};
-		sceneBufferInfo.buffer = mUniformBuffers[i];
+		sceneBufferInfo.buffer = frame.mUniformBuffer.mBuffer;
 		sceneBufferInfo.offset = offsetof(UniformBufferObject, scene);
 		sceneBufferInfo.range = sizeof(SceneUniformBuffer);
 
 		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[0].dstSet = mSceneDescriptorSets[i];
+		descriptorWrites[0].dstSet = frame.mSceneDescriptorSet;
 		descriptorWrites[0].dstBinding = 0;
 		descriptorWrites[0].dstArrayElement = 0;
 		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -1348,92 +2006,263 @@ void VulkanEngine::UpdateDescriptorSets()
 
 		// Frame descriptor
 		VkDescriptorBufferInfo frameBufferInfo = {};
-		frameBufferInfo.buffer = mUniformBuffers[i];
+		frameBufferInfo.buffer = frame.mUniformBuffer.mBuffer;
 		frameBufferInfo.offset = offsetof(UniformBufferObject, frame);
 		frameBufferInfo.range = sizeof(FrameUniformBuffer);
 
 		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[1].dstSet = mFrameDescriptorSets[i];
+		descriptorWrites[1].dstSet = frame.mFrameDescriptorSet;
 		descriptorWrites[1].dstBinding = 0;
 		descriptorWrites[1].dstArrayElement = 0;
 		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		descriptorWrites[1].descriptorCount = 1;
 		descriptorWrites[1].pBufferInfo = &frameBufferInfo;
 
-		// Draw descriptor
-		VkDescriptorBufferInfo drawBufferInfo = {};
-		drawBufferInfo.buffer = mUniformBuffers[i];
-		drawBufferInfo.offset = offsetof(UniformBufferObject, draw);
-		drawBufferInfo.range = sizeof(DrawUniformBuffer);
-
-		descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[2].dstSet = mDrawDescriptorSets[i];
-		descriptorWrites[2].dstBinding = 0;
-		descriptorWrites[2].dstArrayElement = 0;
-		descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-		descriptorWrites[2].descriptorCount = 1;
-		descriptorWrites[2].pBufferInfo = &drawBufferInfo;
-
-		VkDescriptorImageInfo imageInfos[4] = {};
-		for (u32 imageIdx = 0; imageIdx < mTextureImages.size(); ++imageIdx)
-		{
-			imageInfos[imageIdx].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfos[imageIdx].imageView = mTextureImageViews[imageIdx];
-			imageInfos[imageIdx].sampler = nullptr;
-		}
+		vkUpdateDescriptorSets(mDevice, static_cast<u32>(descriptorWrites.size()), descriptorWrites.data(), 0,
+				nullptr);
+	}
+}
+
+void VulkanEngine::WriteInstanceDescriptorSets(FrameResources &frame)
+{
+	// Draw set: instances and visible instances. Cull set: objects, indirect commands, stats and
+	// visible instances.
+	const VkDescriptorSet sets[] = {
+		frame.mDrawDescriptorSet, frame.mDrawDescriptorSet,
+		frame.mCullDescriptorSet, frame.mCullDescriptorSet, frame.mCullDescriptorSet, frame.mCullDescriptorSet
+	};
+	const u32 bindings[] = { 0, 1, 0, 1, 2, 3 };
+	const VkBuffer buffers[] = {
+		frame.mInstanceBuffer.mBuffer, frame.mInstanceIndexBuffer.mBuffer,
+		frame.mCullObjectBuffer.mBuffer, frame.mIndirectBuffer.mBuffer, frame.mCullStatsBuffer.mBuffer,
+		frame.mInstanceIndexBuffer.mBuffer
+	};
 
-		VkDescriptorImageInfo samplerInfo = {};
-		samplerInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; // this necessary?
-		samplerInfo.sampler = mTextureSampler;
+	std::array<VkDescriptorBufferInfo, 6> bufferInfos = {};
+	std::array<VkWriteDescriptorSet, 6> descriptorWrites = {};
+	for (u32 i = 0; i < descriptorWrites.size(); ++i)
+	{
+		bufferInfos[i].buffer = buffers[i];
+		bufferInfos[i].offset = 0;
+		bufferInfos[i].range = VK_WHOLE_SIZE;
+
+		descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[i].dstSet = sets[i];
+		descriptorWrites[i].dstBinding = bindings[i];
+		descriptorWrites[i].dstArrayElement = 0;
+		descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[i].descriptorCount = 1;
+		descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(mDevice, static_cast<u32>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+	// Command buffers that bound the old descriptors can't be submitted anymore
+	frame.mDrawsRecorded = false;
+}
+
+void VulkanEngine::CreateTextureDescriptorSet()
+{
+	std::array<VkDescriptorPoolSize, 3> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+	poolSizes[0].descriptorCount = 1;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	poolSizes[1].descriptorCount = MAX_TEXTURES;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[2].descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.poolSizeCount = static_cast<u32>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = 1;
 
-		descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[3].dstSet = mDrawDescriptorSets[i];
-		descriptorWrites[3].dstBinding = 1;
-		descriptorWrites[3].dstArrayElement = 0;
-		descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
-		descriptorWrites[3].descriptorCount = 1;
-		descriptorWrites[3].pImageInfo = &samplerInfo;
+	VK_ASSERT(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mTextureDescriptorPool));
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = mTextureDescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &mTextureDescriptorSetLayout;
+
+	VK_ASSERT(vkAllocateDescriptorSets(mDevice, &allocInfo, &mTextureDescriptorSet));
+
+	// Textures are written one slot at a time as they are loaded
+	VkDescriptorImageInfo samplerInfo = {};
+	samplerInfo.sampler = mTextureSampler;
+
+	VkWriteDescriptorSet descriptorWrite = {};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = mTextureDescriptorSet;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &samplerInfo;
+	vkUpdateDescriptorSets(mDevice, 1, &descriptorWrite, 0, nullptr);
+}
+
+void VulkanEngine::CreateMaterialTable()
+{
+	CreateMappedBuffer(sizeof(MaterialData) * MAX_MATERIALS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, mMaterialBuffer);
+
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = mMaterialBuffer.mBuffer;
+	bufferInfo.offset = 0;
+	bufferInfo.range = sizeof(MaterialData) * MAX_MATERIALS;
+
+	VkWriteDescriptorSet descriptorWrite = {};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = mTextureDescriptorSet;
+	descriptorWrite.dstBinding = 2;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pBufferInfo = &bufferInfo;
+	vkUpdateDescriptorSets(mDevice, 1, &descriptorWrite, 0, nullptr);
+
+	// Components start out with slot 0, so it has to be something that draws without a texture
+	CreateMaterial(Material { MATERIALFEATURE_VERTEX_COLOR, 0, glm::vec4(1.0f) });
+}
 
-		descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[4].dstSet = mDrawDescriptorSets[i];
-		descriptorWrites[4].dstBinding = 2;
-		descriptorWrites[4].dstArrayElement = 0;
-		descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-		descriptorWrites[4].descriptorCount = static_cast<u32>(mTextureImages.size());
-		descriptorWrites[4].pImageInfo = imageInfos;
+u32 VulkanEngine::CreateMaterial(const Material &material)
+{
+	ARC_ASSERT(material.mFeatures < (1u << MATERIAL_FEATURE_COUNT));
+	ARC_ASSERT(!(material.mFeatures & MATERIALFEATURE_TEXTURE) || material.mTextureSlot < mTextures.size());
 
-		// Update
-		vkUpdateDescriptorSets(mDevice, static_cast<u32>(descriptorWrites.size()),
-				descriptorWrites.data(), 0, nullptr);
+	u32 slot;
+	if (!mFreeMaterialSlots.empty())
+	{
+		slot = mFreeMaterialSlots.back();
+		mFreeMaterialSlots.pop_back();
 	}
+	else
+	{
+		slot = static_cast<u32>(mMaterials.size());
+		ARC_ASSERT(slot < MAX_MATERIALS);
+		mMaterials.emplace_back();
+	}
+	mMaterials[slot] = material;
+
+	// Nothing in flight draws with a free slot, so it can be written right away
+	MaterialData &data = mMaterialBuffer.As<MaterialData>()[slot];
+	data.baseColor = material.mBaseColor;
+	data.textureIndex = material.mTextureSlot;
+	mMaterialBuffer.MarkDirty(sizeof(MaterialData) * slot, sizeof(MaterialData));
+	FlushMappedBuffer(mMaterialBuffer);
+
+	return slot;
 }
 
-void VulkanEngine::CreateCommandBuffers()
+void VulkanEngine::DestroyMaterial(u32 slot)
 {
-	mCommandBuffers.resize(mSwapChainFramebuffers.size());
+	ARC_ASSERT(slot != 0 && slot < mMaterials.size());
 
+	ComponentManager *componentManager = ComponentManager::Instance();
+	for (u32 i = 0; i < componentManager->GetGraphicComponentCount(); ++i)
+		ARC_ASSERT(componentManager->GetGraphicComponent(i).mMaterialIndex != slot);
+
+	// Cleared so it no longer holds on to its texture. Its row may still be read by frames in flight,
+	// so the slot can't be rewritten before they're done.
+	mMaterials[slot] = Material {};
+	DeferFreeSlot(DEFERRED_MATERIAL_SLOT, slot);
+}
+
+void VulkanEngine::CreateCommandBuffers()
+{
+	// Recorded every frame, so one per frame in flight rather than per swap chain image
 	VkCommandBufferAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandPool = mCommandPool;
 	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = static_cast<u32>(mCommandBuffers.size());
+	allocInfo.commandBufferCount = 1;
+
+	for (FrameResources &frame : mFrames)
+	{
+		frame.mCommandPool = CreateTransientCommandPool();
+		allocInfo.commandPool = frame.mCommandPool;
+		VK_ASSERT(vkAllocateCommandBuffers(mDevice, &allocInfo, &frame.mCommandBuffer));
+	}
 
-	VK_ASSERT(vkAllocateCommandBuffers(mDevice, &allocInfo, mCommandBuffers.data()));
+	// Draw recording, one pool and secondary command buffer per task. There are never more tasks
+	// than threads.
+	VkCommandBufferAllocateInfo recordAllocInfo = {};
+	recordAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	recordAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	recordAllocInfo.commandBufferCount = 1;
+
+	const u32 taskCount = mRecordWorkers.GetThreadCount();
+	for (FrameResources &frame : mFrames)
+	{
+		frame.mRecordCommandPools.resize(taskCount);
+		frame.mRecordCommandBuffers.resize(taskCount);
+		for (u32 i = 0; i < taskCount; ++i)
+		{
+			frame.mRecordCommandPools[i] = CreateTransientCommandPool();
+			recordAllocInfo.commandPool = frame.mRecordCommandPools[i];
+			VK_ASSERT(vkAllocateCommandBuffers(mDevice, &recordAllocInfo, &frame.mRecordCommandBuffers[i]));
+		}
+	}
+}
+
+static bool IsMeshletVisible(const Meshlet &meshlet, const Frustum &frustum, const glm::vec3 &cameraPosition)
+{
+	const glm::vec3 center(meshlet.mCenter[0], meshlet.mCenter[1], meshlet.mCenter[2]);
+	if (!frustum.IntersectsSphere(center, meshlet.mRadius))
+		return false;
+
+	if (meshlet.mConeCutoff < 1.0f)
+	{
+		const glm::vec3 apex(meshlet.mConeApex[0], meshlet.mConeApex[1], meshlet.mConeApex[2]);
+		const glm::vec3 axis(meshlet.mConeAxis[0], meshlet.mConeAxis[1], meshlet.mConeAxis[2]);
+		if (glm::dot(glm::normalize(apex - cameraPosition), axis) >= meshlet.mConeCutoff)
+			return false;
+	}
+
+	return true;
 }
 
-void VulkanEngine::UpdateCommandBuffer(u32 frame)
+void VulkanEngine::UpdateCommandBuffer(u32 imageIndex)
 {
+	FrameResources &frame = mFrames[mCurrentFrame];
+	const VkCommandBuffer commandBuffer = frame.mCommandBuffer;
+
+	// The frame is done, so everything allocated for it goes back at once
+	VK_ASSERT(vkResetCommandPool(mDevice, frame.mCommandPool, 0));
+
 	VkCommandBufferBeginInfo beginInfo = {};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = 0;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 	beginInfo.pInheritanceInfo = nullptr;
-	VK_ASSERT(vkBeginCommandBuffer(mCommandBuffers[frame], &beginInfo));
+	VK_ASSERT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
 
 	// COMMANDS
+	mFrameStats = {};
+	if (mCulling.mGpuCulling)
+	{
+		RecordCulling(commandBuffer, frame);
+	}
+	else
+	{
+		// Whole components first, all at once against their world space bounding spheres
+		mWorldBounds.Clear();
+		for (auto it = ComponentManager::Instance()->GraphicComponentsBegin();
+				it != ComponentManager::Instance()->GraphicComponentsEnd(); ++it)
+		{
+			const GraphicResource *res = it->mGraphicResource;
+			const glm::vec3 center(it->mTransform * glm::vec4(res->GetBoundsCenter(), 1.0f));
+			mWorldBounds.Add(center, res->GetBoundsRadius() * GetMaxScale(it->mTransform));
+		}
+
+		mFrameStats.mVisibleComponents = CullSpheres(Frustum(mProjMatrix * mViewMatrix), mWorldBounds,
+				mComponentVisibility);
+		mFrameStats.mCulledComponents = mWorldBounds.mCount - mFrameStats.mVisibleComponents;
+	}
+
 	VkRenderPassBeginInfo renderPassInfo = {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassInfo.renderPass = mRenderPass;
-	renderPassInfo.framebuffer = mSwapChainFramebuffers[frame];
+	renderPassInfo.framebuffer = mSwapChainFramebuffers[imageIndex];
 	renderPassInfo.renderArea.offset = { 0, 0 };
 	renderPassInfo.renderArea.extent = mSwapChainExtent;
 
@@ -1444,117 +2273,590 @@ void VulkanEngine::UpdateCommandBuffer(u32 frame)
 	renderPassInfo.clearValueCount = static_cast<u32>(clearValues.size());
 	renderPassInfo.pClearValues = clearValues.data();
 
-	vkCmdBeginRenderPass(mCommandBuffers[frame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(mCommandBuffers[frame], VK_PIPELINE_BIND_POINT_GRAPHICS, mGraphicsPipeline);
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-	VkBuffer vertexBuffers[] = { mVertexBuffer };
-	VkDeviceSize offsets[] = { 0 };
-	vkCmdBindVertexBuffers(mCommandBuffers[frame], 0, 1, vertexBuffers, offsets);
+	if (CanReuseRecordedDraws(frame))
+	{
+		mFrameStats.mDrawCalls += frame.mRecordedDrawCalls;
+	}
+	else
+	{
+		// Pipelines are created the first time they are drawn with, which can't happen on the workers
+		for (const DrawGroup &group : mDrawGroups)
+			GetGraphicsPipeline(group.mResource->GetVertexLayout(), mMaterials[group.mMaterialIndex].mFeatures);
+
+		// Contiguous ranges of draw groups, one per thread unless that would make them too small
+		const u32 groupCount = static_cast<u32>(mDrawGroups.size());
+		const u32 taskCount = std::clamp((groupCount + MIN_DRAW_GROUPS_PER_TASK - 1) / MIN_DRAW_GROUPS_PER_TASK, 1u,
+				static_cast<u32>(frame.mRecordCommandBuffers.size()));
+		mRecordTasks.resize(taskCount);
+		for (u32 i = 0; i < taskCount; ++i)
+		{
+			RecordTask &task = mRecordTasks[i];
+			task.mFirstGroup = static_cast<u32>(static_cast<u64>(groupCount) * i / taskCount);
+			task.mEndGroup = static_cast<u32>(static_cast<u64>(groupCount) * (i + 1) / taskCount);
+			task.mStats = {};
+			task.mFirstDirtyInstance = UINT32_MAX;
+			task.mEndDirtyInstance = 0;
+		}
 
-	vkCmdBindIndexBuffer(mCommandBuffers[frame], mIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		mRecordWorkers.Run(taskCount, [&](u32 taskIndex)
+		{
+			RecordDraws(frame, taskIndex, mRecordTasks[taskIndex]);
+		});
 
-	vkCmdBindDescriptorSets(mCommandBuffers[frame], VK_PIPELINE_BIND_POINT_GRAPHICS,
-			mPipelineLayout, DS_SCENE, 1, &mSceneDescriptorSets[frame], 0, nullptr);
+		FrameStats recordedStats = {};
+		for (const RecordTask &task : mRecordTasks)
+		{
+			recordedStats.mVisibleMeshlets += task.mStats.mVisibleMeshlets;
+			recordedStats.mCulledMeshlets += task.mStats.mCulledMeshlets;
+			recordedStats.mDrawCalls += task.mStats.mDrawCalls;
+			recordedStats.mTriangles += task.mStats.mTriangles;
+			recordedStats.mBinds += task.mStats.mBinds;
+			recordedStats.mRedundantBinds += task.mStats.mRedundantBinds;
+			if (task.mFirstDirtyInstance < task.mEndDirtyInstance)
+				frame.mInstanceIndexBuffer.MarkDirty(sizeof(u32) * task.mFirstDirtyInstance,
+						sizeof(u32) * (task.mEndDirtyInstance - task.mFirstDirtyInstance));
+		}
+		mFrameStats.mVisibleMeshlets += recordedStats.mVisibleMeshlets;
+		mFrameStats.mCulledMeshlets += recordedStats.mCulledMeshlets;
+		mFrameStats.mDrawCalls += recordedStats.mDrawCalls;
+		mFrameStats.mRecordedDrawCalls = recordedStats.mDrawCalls;
+		mFrameStats.mTriangles += recordedStats.mTriangles;
+		mFrameStats.mBinds += recordedStats.mBinds;
+		mFrameStats.mRedundantBinds += recordedStats.mRedundantBinds;
+
+		// CPU culling changes the draws themselves every frame
+		frame.mDrawsRecorded = mCulling.mGpuCulling;
+		frame.mRecordedTaskCount = taskCount;
+		frame.mRecordedDrawCalls = recordedStats.mDrawCalls;
+		frame.mRecordedExtent = mSwapChainExtent;
+		frame.mRecordedStateKeys.resize(groupCount);
+		for (u32 i = 0; i < groupCount; ++i)
+			frame.mRecordedStateKeys[i] = GetDrawStateKey(mDrawGroups[i]);
+	}
+
+	// Tasks are in draw group order, so draws go out in the same order as when recorded inline
+	vkCmdExecuteCommands(commandBuffer, frame.mRecordedTaskCount, frame.mRecordCommandBuffers.data());
+
+	vkCmdEndRenderPass(commandBuffer);
+	// END COMMANDS
 
-	vkCmdBindDescriptorSets(mCommandBuffers[frame], VK_PIPELINE_BIND_POINT_GRAPHICS,
-			mPipelineLayout, DS_FRAME, 1, &mFrameDescriptorSets[frame], 0, nullptr);
+	VK_ASSERT(vkEndCommandBuffer(commandBuffer));
+}
+
+bool VulkanEngine::CanReuseRecordedDraws(const FrameResources &frame) const
+{
+	if (!frame.mDrawsRecorded)
+		return false;
+	if (frame.mRecordedExtent.width != mSwapChainExtent.width || frame.mRecordedExtent.height != mSwapChainExtent.height)
+		return false;
 
-	u32 firstVertex = 0;
-	u32 firstIndex = 0;
-	u32 drawIndex = 0;
-	for (auto it = ComponentManager::Instance()->GraphicComponentsBegin();
-			it != ComponentManager::Instance()->GraphicComponentsEnd(); ++it)
+	// Indirect commands are written by the culling shader, so only the pipeline and buffers bound for
+	// each group end up in the recording. Groups coming and going shift runs, and change the count.
+	if (frame.mRecordedStateKeys.size() != mDrawGroups.size())
+		return false;
+	for (u32 i = 0; i < mDrawGroups.size(); ++i)
 	{
-		u32 offset = sizeof(glm::mat4) * drawIndex;
-		vkCmdBindDescriptorSets(mCommandBuffers[frame], VK_PIPELINE_BIND_POINT_GRAPHICS,
-			mPipelineLayout, DS_DRAW, 1, &mDrawDescriptorSets[frame], 1, &offset);
+		if (GetDrawStateKey(mDrawGroups[i]) != frame.mRecordedStateKeys[i])
+			return false;
+	}
+	return true;
+}
+
+void VulkanEngine::RecordDraws(FrameResources &frame, u32 taskIndex, RecordTask &task)
+{
+	// The frame is done, so its buffer can go back to the pool with everything else allocated from it
+	VK_ASSERT(vkResetCommandPool(mDevice, frame.mRecordCommandPools[taskIndex], 0));
+	const VkCommandBuffer commandBuffer = frame.mRecordCommandBuffers[taskIndex];
+
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = mRenderPass;
+	inheritanceInfo.subpass = 0;
+	// Left unknown so the recording works with any swap chain image and can be submitted again
+	inheritanceInfo.framebuffer = VK_NULL_HANDLE;
 
-		vkCmdPushConstants(mCommandBuffers[frame], mPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(u32), &drawIndex);
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+	VK_ASSERT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+	// Secondary command buffers don't inherit any state, each one sets up everything its draws use
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = static_cast<float>(mSwapChainExtent.width);
+	viewport.height = static_cast<float>(mSwapChainExtent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-		const GraphicResource *res = it->mGraphicResource;
+	VkRect2D scissor = {};
+	scissor.offset = { 0, 0 };
+	scissor.extent = mSwapChainExtent;
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	CommandStateTracker state(commandBuffer);
+
+	state.BindDescriptorSet(mPipelineLayout, DS_SCENE, frame.mSceneDescriptorSet);
+	state.BindDescriptorSet(mPipelineLayout, DS_FRAME, frame.mFrameDescriptorSet);
+	// Draws find their instances through firstInstance, so this is bound once for all of them
+	state.BindDescriptorSet(mPipelineLayout, DS_DRAW, frame.mDrawDescriptorSet);
+	// Materials index the material and texture tables, so they are bound once too
+	state.BindDescriptorSet(mPipelineLayout, DS_TEXTURES, mTextureDescriptorSet);
+
+	// Every mesh starts at the same vertex number in both heaps, so they are bound once too and draws
+	// only pass vertexOffset
+	VertexAllocator &vertexAllocator = ResourceManager::Instance()->GetVertexAllocator();
+	const VkBuffer vertexBuffers[] = { mVertexBuffer, mVertexBuffer };
+	const VkDeviceSize vertexBufferOffsets[] = {
+		vertexAllocator.GetPositionHeapOffset(),
+		vertexAllocator.GetAttributeHeapOffset()
+	};
+	state.BindVertexBuffers(VertexLayout::BINDING_POSITION, 2, vertexBuffers, vertexBufferOffsets);
 
-		vkCmdDrawIndexed(mCommandBuffers[frame], res->GetIndexCount(), 1, firstIndex, firstVertex, 0);
-		firstVertex += res->GetVertexCount();
-		firstIndex += res->GetIndexCount();
-		++drawIndex;
+	// Meshes mix 16 and 32-bit indices, vertex layouts and constant attributes in the same buffers,
+	// the tracker drops whatever didn't change since the previous draw
+	auto bindDrawState = [&](const DrawGroup &group)
+	{
+		const GraphicResource *res = group.mResource;
+		const VertexLayout &vertexLayout = res->GetVertexLayout();
+		state.BindPipeline(GetGraphicsPipeline(vertexLayout, mMaterials[group.mMaterialIndex].mFeatures));
+
+		if (vertexLayout.HasConstantAttributes())
+		{
+			const VkDeviceSize constantOffset = res->GetConstantAttributeOffset();
+			state.BindVertexBuffers(VertexLayout::BINDING_CONSTANT, 1, &mVertexBuffer, &constantOffset);
+		}
+
+		state.BindIndexBuffer(mIndexBuffer, 0, GetIndexType(res->GetIndexSize()));
+	};
+
+	if (mCulling.mGpuCulling)
+	{
+		// Groups are sorted by draw state and their commands written in the same order, each run that
+		// shares a state goes out as a single multi-draw. Runs that cross a task boundary are split.
+		u32 runStart = task.mFirstGroup;
+		while (runStart < task.mEndGroup)
+		{
+			const u64 stateKey = GetDrawStateKey(mDrawGroups[runStart]);
+
+			u32 runEnd = runStart + 1;
+			while (runEnd < task.mEndGroup && GetDrawStateKey(mDrawGroups[runEnd]) == stateKey)
+				++runEnd;
+
+			bindDrawState(mDrawGroups[runStart]);
+
+			// Groups with no visible instances come out of the culling shader with an instance count of zero
+			const VkDeviceSize stride = sizeof(VkDrawIndexedIndirectCommand);
+			if (mSupportsMultiDrawIndirect)
+			{
+				vkCmdDrawIndexedIndirect(commandBuffer, frame.mIndirectBuffer.mBuffer, stride * runStart,
+						runEnd - runStart, static_cast<u32>(stride));
+				++task.mStats.mDrawCalls;
+			}
+			else
+			{
+				for (u32 command = runStart; command < runEnd; ++command)
+					vkCmdDrawIndexedIndirect(commandBuffer, frame.mIndirectBuffer.mBuffer, stride * command, 1,
+							static_cast<u32>(stride));
+				task.mStats.mDrawCalls += runEnd - runStart;
+			}
+
+			runStart = runEnd;
+		}
+	}
+	else
+	{
+		// Index ranges of the meshlets that survive culling, neighbours merged into a single draw
+		struct IndexRange
+		{
+			u32 mFirstIndex;
+			u32 mIndexCount;
+		};
+		std::vector<IndexRange> drawRanges;
+
+		u32 *instanceIndices = frame.mInstanceIndexBuffer.As<u32>();
+
+		for (u32 groupIndex = task.mFirstGroup; groupIndex < task.mEndGroup; ++groupIndex)
+		{
+			const DrawGroup &group = mDrawGroups[groupIndex];
+
+			// Visible instances are packed at the start of the group's range
+			u32 visibleCount = 0;
+			u32 lastVisible = 0;
+			for (u32 i = group.mFirstInstance; i < group.mFirstInstance + group.mInstanceCount; ++i)
+			{
+				if (!mComponentVisibility[mInstanceComponents[i]])
+					continue;
+				instanceIndices[group.mFirstInstance + visibleCount++] = i;
+				lastVisible = i;
+			}
+			if (visibleCount == 0)
+				continue;
+			task.mFirstDirtyInstance = std::min(task.mFirstDirtyInstance, group.mFirstInstance);
+			task.mEndDirtyInstance = std::max(task.mEndDirtyInstance, group.mFirstInstance + visibleCount);
+
+			const GraphicResource *res = group.mResource;
+			const MeshLod &lod = res->GetLods()[group.mLod];
+
+			drawRanges.clear();
+			if (visibleCount == 1)
+			{
+				// Meshlet culling depends on the instance, so only single instances get it. Meshlet bounds
+				// are in object space, so cull there instead of transforming every meshlet.
+				const GraphicComponent &component =
+						ComponentManager::Instance()->GetGraphicComponent(mInstanceComponents[lastVisible]);
+				const glm::mat4 modelView = mViewMatrix * component.mTransform;
+				const Frustum frustum(mProjMatrix * modelView);
+				const glm::vec3 cameraPosition(glm::inverse(modelView)[3]);
+
+				const Meshlet *meshlets = res->GetMeshlets().data() + lod.mMeshletOffset;
+				for (u32 i = 0; i < lod.mMeshletCount; ++i)
+				{
+					const Meshlet &meshlet = meshlets[i];
+					if (!IsMeshletVisible(meshlet, frustum, cameraPosition))
+					{
+						++task.mStats.mCulledMeshlets;
+						continue;
+					}
+					++task.mStats.mVisibleMeshlets;
+					task.mStats.mTriangles += meshlet.mIndexCount / 3;
+
+					if (!drawRanges.empty() &&
+							drawRanges.back().mFirstIndex + drawRanges.back().mIndexCount == meshlet.mIndexOffset)
+						drawRanges.back().mIndexCount += meshlet.mIndexCount;
+					else
+						drawRanges.push_back(IndexRange { meshlet.mIndexOffset, meshlet.mIndexCount });
+				}
+				if (drawRanges.empty())
+					continue;
+			}
+			else
+			{
+				drawRanges.push_back(IndexRange { lod.mIndexOffset, lod.mIndexCount });
+				task.mStats.mTriangles += lod.mIndexCount / 3 * visibleCount;
+			}
+
+			bindDrawState(group);
+
+			const u32 firstIndex = static_cast<u32>(res->GetIndexBufferOffset() / res->GetIndexSize());
+			const s32 vertexOffset = static_cast<s32>(res->GetFirstVertex());
+			for (const IndexRange &range : drawRanges)
+				vkCmdDrawIndexed(commandBuffer, range.mIndexCount, visibleCount,
+						firstIndex + range.mFirstIndex, vertexOffset, group.mFirstInstance);
+			task.mStats.mDrawCalls += static_cast<u32>(drawRanges.size());
+		}
 	}
-	vkCmdEndRenderPass(mCommandBuffers[frame]);
-	// END COMMANDS
 
-	VK_ASSERT(vkEndCommandBuffer(mCommandBuffers[frame]));
+	task.mStats.mBinds = state.GetStats().mBinds;
+	task.mStats.mRedundantBinds = state.GetStats().mRedundantBinds;
+
+	VK_ASSERT(vkEndCommandBuffer(commandBuffer));
+}
+
+u64 VulkanEngine::GetDrawStateKey(const DrawGroup &group) const
+{
+	// Everything that is bound per draw: pipeline, index type and, for constant attributes, where
+	// they are. Vertex buffer offsets are well under 4GB. Material parameters come from the table,
+	// so groups with different materials of the same features still share a draw.
+	const GraphicResource *res = group.mResource;
+	const u64 pipelineKey = GetGraphicsPipelineKey(res->GetVertexLayout(), mMaterials[group.mMaterialIndex].mFeatures);
+	const u64 constantOffset = res->GetVertexLayout().HasConstantAttributes() ? res->GetConstantAttributeOffset() : 0;
+	return (pipelineKey << 35) | (static_cast<u64>(res->GetIndexSize()) << 32) | constantOffset;
+}
+
+u64 VulkanEngine::GetDrawSortKey(const GraphicComponent &component, u32 pass) const
+{
+	const GraphicResource *res = component.mGraphicResource;
+	ARC_ASSERT(res->GetIndex() < (1u << SORTKEY_RESOURCE_BITS));
+	ARC_ASSERT(component.mLod < (1u << SORTKEY_LOD_BITS));
+	ARC_ASSERT(component.mMaterialIndex < mMaterials.size());
+
+	// Linear view depth of the bounds center, anything past the far plane sorts last
+	const glm::vec3 center(mViewMatrix * component.mTransform * glm::vec4(res->GetBoundsCenter(), 1.0f));
+	const f32 depth = std::clamp(-center.z / CAMERA_FAR, 0.0f, 1.0f);
+	const u64 quantizedDepth = static_cast<u64>(depth * ((1u << SORTKEY_DEPTH_BITS) - 1));
+
+	u64 key = pass;
+	const u32 pipeline = res->GetVertexLayout().GetCompactKey() |
+			(mMaterials[component.mMaterialIndex].mFeatures << VertexLayout::COMPACT_KEY_BITS);
+	key = (key << SORTKEY_PIPELINE_BITS) | pipeline;
+	key = (key << SORTKEY_INDEX_TYPE_BITS) | (res->GetIndexSize() == sizeof(u16) ? 0 : 1);
+	key = (key << SORTKEY_RESOURCE_BITS) | res->GetIndex();
+	key = (key << SORTKEY_LOD_BITS) | component.mLod;
+	key = (key << SORTKEY_MATERIAL_BITS) | component.mMaterialIndex;
+	key = (key << SORTKEY_DEPTH_BITS) | quantizedDepth;
+	return key;
+}
+
+void VulkanEngine::RecordCulling(VkCommandBuffer commandBuffer, FrameResources &frame)
+{
+	// Stats of the last time this frame was recorded, which has completed
+	InvalidateMappedBuffer(frame.mCullStatsBuffer);
+	const CullStats stats = *frame.mCullStatsBuffer.As<CullStats>();
+
+	// Objects are numbered like instances, commands like draw groups
+	ComponentManager *componentManager = ComponentManager::Instance();
+	const u32 objectCount = static_cast<u32>(mInstanceComponents.size());
+
+	CullObject *objects = frame.mCullObjectBuffer.As<CullObject>();
+	VkDrawIndexedIndirectCommand *commands = frame.mIndirectBuffer.As<VkDrawIndexedIndirectCommand>();
+	for (u32 groupIndex = 0; groupIndex < mDrawGroups.size(); ++groupIndex)
+	{
+		const DrawGroup &group = mDrawGroups[groupIndex];
+		const GraphicResource *res = group.mResource;
+		const MeshLod &lod = res->GetLods()[group.mLod];
+
+		VkDrawIndexedIndirectCommand &command = commands[groupIndex];
+		command.indexCount = lod.mIndexCount;
+		command.instanceCount = group.mInstanceCount;
+		command.firstIndex = static_cast<u32>(res->GetIndexBufferOffset() / res->GetIndexSize()) + lod.mIndexOffset;
+		command.vertexOffset = static_cast<s32>(res->GetFirstVertex());
+		command.firstInstance = group.mFirstInstance;
+
+		for (u32 i = group.mFirstInstance; i < group.mFirstInstance + group.mInstanceCount; ++i)
+		{
+			CullObject &object = objects[i];
+			object.model = componentManager->GetGraphicComponent(mInstanceComponents[i]).mTransform;
+			object.boundingSphere = glm::vec4(res->GetBoundsCenter(), res->GetBoundsRadius());
+		}
+	}
+	frame.mCullObjectBuffer.MarkDirty(0, sizeof(CullObject) * objectCount);
+	frame.mIndirectBuffer.MarkDirty(0, sizeof(VkDrawIndexedIndirectCommand) * mDrawGroups.size());
+
+	mFrameStats.mVisibleComponents = std::min(stats.visibleCount, objectCount);
+	mFrameStats.mCulledComponents = objectCount - mFrameStats.mVisibleComponents;
+	mFrameStats.mTriangles = stats.triangleCount;
+
+	vkCmdFillBuffer(commandBuffer, frame.mCullStatsBuffer.mBuffer, 0, sizeof(CullStats), 0);
+
+	VkMemoryBarrier clearBarrier = {};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+	CullPushConstants pushConstants = {};
+	const Frustum frustum(mProjMatrix * mViewMatrix);
+	for (int i = 0; i < Frustum::PLANE_COUNT; ++i)
+		pushConstants.frustumPlanes[i] = frustum.mPlanes[i];
+
+	static_assert(sizeof(CullPushConstants) <= CommandStateTracker::MAX_PUSH_CONSTANT_SIZE,
+			"VulkanEngine: culling push constants don't fit the tracker");
+	CommandStateTracker state(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+	state.BindPipeline(mCullPipeline);
+	state.BindDescriptorSet(mCullPipelineLayout, 0, frame.mCullDescriptorSet);
+	state.PushConstants(mCullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants),
+			&pushConstants);
+	mFrameStats.mBinds += state.GetStats().mBinds;
+	mFrameStats.mRedundantBinds += state.GetStats().mRedundantBinds;
+	// One workgroup per draw group, which compacts its visible instances in sorted order. Groups are
+	// distinct resource, LOD and material combinations, far fewer than the 65535 every device supports.
+	const u32 groupCount = static_cast<u32>(mDrawGroups.size());
+	ARC_ASSERT(groupCount <= 65535);
+	vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+
+	// The commands are read by the draws, the visible instances by the vertex shader and the stats by
+	// the CPU once the frame is done
+	VkMemoryBarrier cullBarrier = {};
+	cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+			VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+			0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
 }
 
 void VulkanEngine::CreateSyncObjects()
 {
-	mImageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	mRenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	mInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-	mImagesInFlight.resize(mSwapChainImages.size(), VK_NULL_HANDLE);
+	mImageAvailableSemaphores.resize(mFramesInFlight);
+	mRenderFinishedSemaphores.resize(mFramesInFlight);
 
 	VkSemaphoreCreateInfo semaphoreInfo = {};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	VkFenceCreateInfo fenceInfo = {};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	for (size_t i = 0; i < mFramesInFlight; ++i)
 	{
 		VK_ASSERT(vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mImageAvailableSemaphores[i]));
 		VK_ASSERT(vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mRenderFinishedSemaphores[i]));
-		VK_ASSERT(vkCreateFence(mDevice, &fenceInfo, nullptr, &mInFlightFences[i]));
 	}
 }
 
-void VulkanEngine::UpdateUniformBuffer(u32 currentImage)
+void VulkanEngine::DestroySyncObjects()
 {
-	static auto startTime = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < mImageAvailableSemaphores.size(); ++i)
+	{
+		vkDestroySemaphore(mDevice, mRenderFinishedSemaphores[i], nullptr);
+		vkDestroySemaphore(mDevice, mImageAvailableSemaphores[i], nullptr);
+	}
+	mRenderFinishedSemaphores.clear();
+	mImageAvailableSemaphores.clear();
+}
 
-	auto currentTime = std::chrono::high_resolution_clock::now();
-	const float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+void VulkanEngine::CreateTimelineSemaphore()
+{
+	VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+	typeInfo.initialValue = mTimelineValue;
 
-	UniformBufferObject ubo = {};
-	ubo.scene.proj = glm::perspective(glm::radians(45.0f), mSwapChainExtent.width / (float) mSwapChainExtent.height, 0.1f, 10.0f);
-	ubo.frame.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.draw[0].model = glm::rotate(glm::mat4(1.0f), time * glm::radians(45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.draw[1].model = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, 0.0f)), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
 
-	// Vulkan correction, flip upside down
-	ubo.scene.proj[1][1] *= -1;
+	VK_ASSERT(vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mTimelineSemaphore));
+}
 
-	void *data;
-	vkMapMemory(mDevice, mUniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
-	memcpy(data, &ubo, sizeof(ubo));
-	vkUnmapMemory(mDevice, mUniformBuffersMemory[currentImage]);
+u64 VulkanEngine::GetCompletedTimelineValue()
+{
+	u64 completedValue;
+	VK_ASSERT(mGetSemaphoreCounterValue(mDevice, mTimelineSemaphore, &completedValue));
+	return completedValue;
 }
 
-void VulkanEngine::CleanUpSwapChain()
+void VulkanEngine::WaitForTimelineValue(u64 value)
 {
-	vkDestroyImageView(mDevice, mDepthImageView, nullptr);
-	vkDestroyImage(mDevice, mDepthImage, nullptr);
-	vkFreeMemory(mDevice, mDepthImageMemory, nullptr);
+	VkSemaphoreWaitInfoKHR waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &mTimelineSemaphore;
+	waitInfo.pValues = &value;
 
-	for (auto framebuffer : mSwapChainFramebuffers)
-		vkDestroyFramebuffer(mDevice, framebuffer, nullptr);
+	VK_ASSERT(mWaitSemaphores(mDevice, &waitInfo, UINT64_MAX));
+}
 
-	vkFreeCommandBuffers(mDevice, mCommandPool, static_cast<u32>(mCommandBuffers.size()), mCommandBuffers.data());
+void VulkanEngine::SetFramePacing(const FramePacingSettings &framePacing)
+{
+	// Rare, so simply wait for everything and rebuild what depends on the number of frames
+	vkDeviceWaitIdle(mDevice);
 
-	vkDestroyPipeline(mDevice, mGraphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
-	vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
+	DestroySyncObjects();
+	DestroyFrameResources();
+	vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
 
-	for (auto imageView : mSwapChainImageViews)
-		vkDestroyImageView(mDevice, imageView, nullptr);
+	mFramePacing = framePacing;
+	mFramesInFlight = framePacing.GetFramesInFlight();
+	mCurrentFrame = 0;
+	mFrameBegun = false;
+	mFrameWaited = false;
 
-	vkDestroySwapchainKHR(mDevice, mSwapChain, nullptr);
+	CreateFrameResources();
+	CreateCommandBuffers();
+	CreateDescriptorPool();
+	CreateDescriptorSets();
+	CreateSyncObjects();
 
-	for (size_t i = 0; i < mSwapChainImages.size(); ++i)
+	// Present mode and image count
+	RecreateSwapChain();
+	ProcessDeletionQueue();
+}
+
+void VulkanEngine::SetCulling(const CullingSettings &culling)
+{
+	mCulling = culling;
+
+	// Draws recorded for the other path can't be submitted again
+	for (FrameResources &frame : mFrames)
+		frame.mDrawsRecorded = false;
+}
+
+void VulkanEngine::UpdateCamera()
+{
+	mProjMatrix = glm::perspective(glm::radians(45.0f), mSwapChainExtent.width / (float) mSwapChainExtent.height,
+			CAMERA_NEAR, CAMERA_FAR);
+	mViewMatrix = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+	// Vulkan correction, flip upside down
+	mProjMatrix[1][1] *= -1;
+}
+
+void VulkanEngine::UpdateLods()
+{
+	// Pixels covered by one unit of length at distance one
+	const f32 pixelsPerUnit = std::abs(mProjMatrix[1][1]) * mSwapChainExtent.height * 0.5f;
+	const glm::vec3 cameraPosition(glm::inverse(mViewMatrix)[3]);
+
+	ComponentManager *componentManager = ComponentManager::Instance();
+	for (u32 i = 0; i < componentManager->GetGraphicComponentCount(); ++i)
 	{
-		vkDestroyBuffer(mDevice, mUniformBuffers[i], nullptr);
-		vkFreeMemory(mDevice, mUniformBuffersMemory[i], nullptr);
+		GraphicComponent &component = componentManager->GetGraphicComponent(i);
+		const GraphicResource *res = component.mGraphicResource;
+		const std::vector<MeshLod> &lods = res->GetLods();
+		const glm::mat4 &transform = component.mTransform;
+
+		// Distance to the closest point of the bounding sphere
+		const f32 scale = GetMaxScale(transform);
+		const glm::vec3 center(transform * glm::vec4(res->GetBoundsCenter(), 1.0f));
+		const f32 distance = std::max(glm::length(center - cameraPosition) - res->GetBoundsRadius() * scale, 0.1f);
+		const f32 pixelsPerError = scale * pixelsPerUnit / distance;
+
+		u32 lod = std::min(component.mLod, static_cast<u32>(lods.size()) - 1);
+		while (lod > 0 && lods[lod].mError * pixelsPerError > LOD_MAX_ERROR_PIXELS)
+			--lod;
+		while (lod + 1 < lods.size() && lods[lod + 1].mError * pixelsPerError < LOD_MAX_ERROR_PIXELS * LOD_HYSTERESIS)
+			++lod;
+		component.mLod = lod;
 	}
+}
 
-	vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
+void VulkanEngine::UpdateInstanceBuffer(FrameResources &frame)
+{
+	ComponentManager *componentManager = ComponentManager::Instance();
+	const u32 instanceCount = componentManager->GetGraphicComponentCount();
+	ReserveInstances(frame, instanceCount);
+
+	mInstanceComponents.resize(instanceCount);
+	mInstanceSortKeys.resize(instanceCount);
+	for (u32 i = 0; i < instanceCount; ++i)
+	{
+		mInstanceComponents[i] = i;
+		mInstanceSortKeys[i] = GetDrawSortKey(componentManager->GetGraphicComponent(i), DRAWPASS_OPAQUE);
+	}
+	RadixSort(mInstanceSortKeys, mInstanceComponents, mSortScratch);
+
+	InstanceData *instances = frame.mInstanceBuffer.As<InstanceData>();
+
+	// Groups are runs of the same key once the depth is dropped
+	mDrawGroups.clear();
+	u64 groupKey = UINT64_MAX;
+	for (u32 i = 0; i < instanceCount; ++i)
+	{
+		const GraphicComponent &component = componentManager->GetGraphicComponent(mInstanceComponents[i]);
+		if ((mInstanceSortKeys[i] >> SORTKEY_GROUP_SHIFT) != groupKey)
+		{
+			groupKey = mInstanceSortKeys[i] >> SORTKEY_GROUP_SHIFT;
+			mDrawGroups.push_back(DrawGroup { component.mGraphicResource, component.mLod, component.mMaterialIndex,
+					i, 0 });
+		}
+		++mDrawGroups.back().mInstanceCount;
+
+		// Quantized positions are decoded as part of the model transform
+		instances[i].model = component.mTransform * component.mGraphicResource->GetPositionTransform();
+		instances[i].materialIndex = component.mMaterialIndex;
+	}
+	frame.mInstanceBuffer.MarkDirty(0, sizeof(InstanceData) * instanceCount);
+}
+
+void VulkanEngine::UpdateUniformBuffer(FrameResources &frame)
+{
+	UniformBufferObject *ubo = frame.mUniformBuffer.As<UniformBufferObject>();
+	ubo->scene.proj = mProjMatrix;
+	ubo->frame.view = mViewMatrix;
+	frame.mUniformBuffer.MarkDirty(0, sizeof(UniformBufferObject));
+}
+
+void VulkanEngine::FlushFrameResources(FrameResources &frame)
+{
+	FlushMappedBuffer(frame.mUniformBuffer);
+	FlushMappedBuffer(frame.mInstanceBuffer);
+	FlushMappedBuffer(frame.mInstanceIndexBuffer);
+	FlushMappedBuffer(frame.mCullObjectBuffer);
+	FlushMappedBuffer(frame.mIndirectBuffer);
 }
 
 bool VulkanEngine::CheckValidationLayerSupport()
@@ -8,6 +8,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -17,8 +18,83 @@
 #include <unordered_map>
 
 #include "ArcGlobals.h"
+#include "render/Culling.h"
+#include "util/RadixSort.h"
+#include "util/VertexLayout.h"
+#include "util/WorkerPool.h"
 
 struct Vertex;
+class GraphicResource;
+struct GraphicComponent;
+
+// Counters for the last recorded frame
+struct FrameStats
+{
+	u32 mVisibleComponents;
+	u32 mCulledComponents;
+	u32 mVisibleMeshlets;
+	u32 mCulledMeshlets;
+	u32 mDrawCalls;
+	// Zero when the draws recorded for an earlier frame were submitted again
+	u32 mRecordedDrawCalls;
+	// State set while recording and state dropped because it was already set. Only the culling
+	// dispatch counts when the draws of an earlier frame were submitted again.
+	u32 mBinds;
+	u32 mRedundantBinds;
+	u32 mTriangles;
+	// From VulkanEngine::BeginFrame to the frame being handed to the presentation engine, averaged
+	f32 mInputLatencyMs;
+};
+
+enum FramePacingMode : u8
+{
+	// For interactive use: a single frame in flight, the CPU waits for the GPU before input is
+	// sampled and presentation replaces queued images instead of waiting for vblank
+	FRAMEPACING_LOW_LATENCY,
+	// For offline renders: a deep frame queue, the CPU only waits when it runs out of frames and
+	// presentation never blocks
+	FRAMEPACING_HIGH_THROUGHPUT
+};
+
+// Optional parts of shaders/shader.frag. Each combination in use gets its own pipeline, with the
+// features it leaves out compiled away.
+enum MaterialFeature : u32
+{
+	MATERIALFEATURE_TEXTURE = 1 << 0,
+	// Multiplies the base color by the mesh's vertex colors
+	MATERIALFEATURE_VERTEX_COLOR = 1 << 1
+};
+
+struct Material
+{
+	// MaterialFeature bits
+	u32 mFeatures;
+	// Slot in the texture table, unused without MATERIALFEATURE_TEXTURE
+	u32 mTextureSlot;
+	glm::vec4 mBaseColor;
+};
+
+struct FramePacingSettings
+{
+	u8 mMode = FRAMEPACING_LOW_LATENCY;
+	// Zero picks the mode's default
+	u32 mFramesInFlight = 0;
+
+	u32 GetFramesInFlight() const
+	{
+		if (mFramesInFlight != 0)
+			return mFramesInFlight;
+		return mMode == FRAMEPACING_LOW_LATENCY ? 1 : 3;
+	}
+};
+
+struct CullingSettings
+{
+	// Cull instances in a compute shader and draw them with one indirect multi-draw per draw state.
+	// Otherwise components and meshlets are culled on the CPU, which also drops meshlets facing away
+	// from the camera but records every draw each frame.
+	bool mGpuCulling = true;
+};
 
 class VulkanEngine
 {
@@ -31,9 +107,25 @@ class VulkanEngine
 		DS_SCENE,
 		DS_FRAME,
 		DS_DRAW,
+		// Shared by all frames, slots are only written while no frame uses them
+		DS_TEXTURES,
 		DS_COUNT
 	};
 
+	// Size of the bindless texture table in shaders/shader.frag
+	static const u32 MAX_TEXTURES = 1024;
+	// Size of the material table, bounded by the material bits of the sort key
+	static const u32 MAX_MATERIALS = 1024;
+	// One specialization constant per MaterialFeature bit, its constant_id is the bit index
+	static const u32 MATERIAL_FEATURE_COUNT = 2;
+
+	struct Texture
+	{
+		VkImage mImage;
+		VkDeviceMemory mMemory;
+		VkImageView mImageView;
+	};
+
 	struct SceneUniformBuffer
 	{
 		alignas(16) glm::mat4 proj;
@@ -44,16 +136,173 @@ class VulkanEngine
 		alignas(16) glm::mat4 view;
 	};
 
-	struct DrawUniformBuffer
+	struct UniformBufferObject
+	{
+		alignas(16) SceneUniformBuffer scene;
+		alignas(16) FrameUniformBuffer frame;
+	};
+
+	// Instance buffers start this big and double whenever a frame needs more
+	static const u32 INITIAL_INSTANCE_CAPACITY = 1024;
+
+	// Layout shared with shaders/shader.vert, one per component
+	struct InstanceData
 	{
 		alignas(16) glm::mat4 model;
+		u32 materialIndex;
+		u32 padding[3];
 	};
 
-	struct UniformBufferObject
+	// Layout shared with shaders/shader.frag, one per material
+	struct MaterialData
 	{
-		alignas(16) SceneUniformBuffer scene;
-		alignas(16) FrameUniformBuffer frame;
-		alignas(16) DrawUniformBuffer draw[16];
+		glm::vec4 baseColor;
+		u32 textureIndex;
+		u32 padding[3];
+	};
+
+	// Components drawing the same LOD of the same resource with the same material, drawn with a single
+	// instanced draw. Their instances are contiguous in the instance buffer.
+	struct DrawGroup
+	{
+		const GraphicResource *mResource;
+		u32 mLod;
+		u32 mMaterialIndex;
+		u32 mFirstInstance;
+		u32 mInstanceCount;
+	};
+
+	enum EDrawPasses
+	{
+		DRAWPASS_OPAQUE
+	};
+
+	// Draws are ordered by a 64-bit key, most significant bits first: pass, pipeline, index type,
+	// resource, LOD, material and view depth. Everything above the depth identifies a draw group, so
+	// a group's instances end up next to each other, nearest first for early depth rejection.
+	// The pipeline covers the vertex layout and the material's features. Past that, materials only
+	// pick a row of the material table, so they come after the geometry.
+	static const u32 SORTKEY_DEPTH_BITS = 16;
+	static const u32 SORTKEY_MATERIAL_BITS = 10;
+	static const u32 SORTKEY_LOD_BITS = 4;
+	static const u32 SORTKEY_RESOURCE_BITS = 14;
+	static const u32 SORTKEY_INDEX_TYPE_BITS = 1;
+	static const u32 SORTKEY_PIPELINE_BITS = VertexLayout::COMPACT_KEY_BITS + MATERIAL_FEATURE_COUNT;
+	static const u32 SORTKEY_GROUP_SHIFT = SORTKEY_DEPTH_BITS;
+	static_assert(MAX_MATERIALS <= (1u << SORTKEY_MATERIAL_BITS), "VulkanEngine: material slots don't fit the sort key");
+
+	// Tasks below this many draw groups aren't worth handing to another thread
+	static const u32 MIN_DRAW_GROUPS_PER_TASK = 256;
+
+	// Contiguous range of draw groups recorded by one task, and what it found along the way
+	struct RecordTask
+	{
+		u32 mFirstGroup;
+		u32 mEndGroup;
+		FrameStats mStats;
+		// Instance indices written by CPU culling, flushed once every task is done
+		u32 mFirstDirtyInstance;
+		u32 mEndDirtyInstance;
+	};
+
+	// Layout shared with shaders/cull.comp, one per instance
+	struct CullObject
+	{
+		alignas(16) glm::mat4 model;
+		// Object space center and radius
+		alignas(16) glm::vec4 boundingSphere;
+	};
+
+	struct CullPushConstants
+	{
+		glm::vec4 frustumPlanes[Frustum::PLANE_COUNT];
+	};
+
+	// Written by the culling shader, read back once the frame is done
+	struct CullStats
+	{
+		u32 visibleCount;
+		u32 triangleCount;
+	};
+
+	// Host visible buffer, mapped for as long as it lives. Written ranges are tracked so memory that
+	// isn't host coherent can be flushed before the GPU reads it.
+	struct MappedBuffer
+	{
+		VkBuffer mBuffer;
+		VkDeviceMemory mMemory;
+		u8 *mData;
+		// Of the allocation, which can be larger than the buffer
+		VkDeviceSize mSize;
+		bool mCoherent;
+		VkDeviceSize mDirtyBegin;
+		VkDeviceSize mDirtyEnd;
+
+		template<typename T>
+		T *As() { return reinterpret_cast<T *>(mData); }
+
+		void MarkDirty(VkDeviceSize offset, VkDeviceSize size)
+		{
+			mDirtyBegin = std::min(mDirtyBegin, offset);
+			mDirtyEnd = std::max(mDirtyEnd, offset + size);
+		}
+	};
+
+	// Everything the CPU writes for a frame, one per frame in flight. Only touched once the timeline
+	// has reached the frame's value.
+	struct FrameResources
+	{
+		// Timeline value signaled by the frame's last submission
+		u64 mTimelineValue;
+		VkCommandPool mCommandPool;
+		VkCommandBuffer mCommandBuffer;
+		// Draws are recorded into secondary command buffers, one per recording task, each from its
+		// own pool so tasks never share one. Reset together once the frame is done.
+		std::vector<VkCommandPool> mRecordCommandPools;
+		std::vector<VkCommandBuffer> mRecordCommandBuffers;
+		// With GPU culling the recorded draws are submitted again for as long as what they depend on
+		// stays the same: the draw state of every group and the extent. Descriptor sets and render
+		// pass changes clear mDrawsRecorded.
+		bool mDrawsRecorded;
+		u32 mRecordedTaskCount;
+		u32 mRecordedDrawCalls;
+		VkExtent2D mRecordedExtent;
+		std::vector<u64> mRecordedStateKeys;
+		MappedBuffer mUniformBuffer;
+		// Capacity in instances, which also sizes the culling objects and indirect commands
+		u32 mInstanceCapacity;
+		MappedBuffer mInstanceBuffer;
+		MappedBuffer mInstanceIndexBuffer;
+		MappedBuffer mCullObjectBuffer;
+		MappedBuffer mIndirectBuffer;
+		MappedBuffer mCullStatsBuffer;
+		VkDescriptorSet mSceneDescriptorSet;
+		VkDescriptorSet mFrameDescriptorSet;
+		VkDescriptorSet mDrawDescriptorSet;
+		VkDescriptorSet mCullDescriptorSet;
+	};
+
+	enum EDeferredObjects
+	{
+		DEFERRED_MEMORY,
+		DEFERRED_IMAGE,
+		DEFERRED_IMAGE_VIEW,
+		DEFERRED_FRAMEBUFFER,
+		DEFERRED_PIPELINE,
+		DEFERRED_RENDER_PASS,
+		DEFERRED_SWAPCHAIN,
+		// Not Vulkan objects, the slots only go back to their free lists
+		DEFERRED_TEXTURE_SLOT,
+		DEFERRED_MATERIAL_SLOT
+	};
+
+	// Object released while submissions that may use it are still in flight
+	struct DeferredDestroy
+	{
+		// Last timeline value submitted when it was released
+		u64 mTimelineValue;
+		u64 mHandle;
+		u8 mType;
 	};
 
 	const std::vector<const char *> mValidationLayers = {
@@ -61,10 +310,21 @@ class VulkanEngine
 	};
 
 	const std::vector<const char *> mDeviceExtensions = {
-		VK_KHR_SWAPCHAIN_EXTENSION_NAME
+		VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+		VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+		VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME
 	};
 
-	const u32 MAX_FRAMES_IN_FLIGHT = 2;
+	// Compiled pipelines from previous runs, written back at shutdown
+	const std::string PIPELINE_CACHE_PATH = "pipeline.cache";
+
+	const f32 CAMERA_NEAR = 0.1f;
+	const f32 CAMERA_FAR = 10.0f;
+
+	// A LOD is used while its error projects to less than this many pixels. Switching to a coarser
+	// one needs it to be under LOD_HYSTERESIS times that, so LODs don't flicker at the boundary.
+	const f32 LOD_MAX_ERROR_PIXELS = 1.0f;
+	const f32 LOD_HYSTERESIS = 0.75f;
 
 	struct QueueFamilyIndices
 	{
@@ -91,17 +351,37 @@ class VulkanEngine
 #endif
 
 public:
-	static void Initialize(GLFWwindow *window, VkSurfaceKHR surface);
+	static void Initialize(GLFWwindow *window, VkSurfaceKHR surface,
+			const FramePacingSettings &framePacing = FramePacingSettings(),
+			const CullingSettings &culling = CullingSettings());
+	// Call right before sampling input. In low latency mode this is where the CPU waits for the
+	// GPU, so the frame is built from the freshest input possible. Called by DrawFrame otherwise.
+	void BeginFrame();
 	void DrawFrame();
-	void LoadTextureFromImage(void *pixels, u32 width, u32 height);
+	// Waits for the device and rebuilds the per frame objects and the swap chain
+	void SetFramePacing(const FramePacingSettings &framePacing);
+	const FramePacingSettings &GetFramePacing() const { return mFramePacing; }
+	// Takes effect with the next frame recorded
+	void SetCulling(const CullingSettings &culling);
+	const CullingSettings &GetCulling() const { return mCulling; }
+	// Returns the texture's slot in the texture table, which is what materials refer to it by
+	u32 LoadTextureFromImage(void *pixels, u32 width, u32 height);
+	// No material may refer to the slot anymore
+	void UnloadTexture(u32 slot);
+	// Returns the material's slot, which components refer to it by. Slot 0 is an untextured one using
+	// vertex colors, and lives until CleanUp.
+	u32 CreateMaterial(const Material &material);
+	// No component may refer to the slot anymore
+	void DestroyMaterial(u32 slot);
+	const Material &GetMaterial(u32 slot) const { return mMaterials[slot]; }
 	void CleanUp();
 	void WaitForDevice();
+	const FrameStats &GetFrameStats() const { return mFrameStats; }
 
 	// public for now
 	void FillVertexBuffer(void *dataSrc, size_t offset, size_t dataSize);
 	void FillIndexBuffer(void *dataSrc, size_t offset, size_t dataSize);
-	void UpdateCommandBuffer(u32 frame);
-	void UpdateDescriptorSets();
+	void UpdateCommandBuffer(u32 imageIndex);
 
 	static void FramebufferResizeCallback(GLFWwindow *window, int width, int height)
 	{
@@ -117,6 +397,8 @@ private:
 	void CreateSurface();
 	void PickPhysicalDevice();
 	bool IsDeviceSuitable(VkPhysicalDevice device);
+	bool CheckDescriptorIndexingSupport(VkPhysicalDevice device);
+	bool CheckTimelineSemaphoreSupport(VkPhysicalDevice device);
 	bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
 	QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device);
 	void CreateLogicalDevice();
@@ -129,10 +411,19 @@ private:
 	void CreateSwapChainImageViews();
 	void CreateRenderPass();
 	void CreateDescriptorSetLayouts();
-	void CreateGraphicsPipeline();
+	void CreatePipelineCache();
+	void SavePipelineCache();
+	bool IsPipelineCacheCompatible(const std::vector<char> &data);
+	void CreatePipelineLayout();
+	void CreateCullPipeline();
+	VkPipeline CreateGraphicsPipeline(const VertexLayout &vertexLayout, u32 materialFeatures);
+	// Variants are created the first time they are asked for
+	VkPipeline GetGraphicsPipeline(const VertexLayout &vertexLayout, u32 materialFeatures);
+	static u32 GetGraphicsPipelineKey(const VertexLayout &vertexLayout, u32 materialFeatures);
 	VkShaderModule CreateShaderModule(const std::vector<char> &code);
 	void CreateFramebuffers();
-	void CreateCommandPool();
+	VkCommandPool CreateTransientCommandPool();
+	void CreateUploadCommandPool();
 	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
 			VkBuffer &buffer, VkDeviceMemory &bufferMemory);
 	void CreateDepthResources();
@@ -153,15 +444,70 @@ private:
 	void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
 	void CopyBufferToImage(VkBuffer buffer, VkImage image, u32 width, u32 height);
 	u32 FindMemoryType(u32 typeFilter, VkMemoryPropertyFlags properties);
-	void CreateUniformBuffers();
+	// Returns UINT32_MAX instead of breaking when there is no such type
+	u32 TryFindMemoryType(u32 typeFilter, VkMemoryPropertyFlags properties);
+	void CreateMappedBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MappedBuffer &buffer);
+	void DestroyMappedBuffer(MappedBuffer &buffer);
+	// Makes the dirty range visible to the GPU and clears it
+	void FlushMappedBuffer(MappedBuffer &buffer);
+	// Makes GPU writes visible to the CPU
+	void InvalidateMappedBuffer(MappedBuffer &buffer);
+	void CreateFrameResources();
+	void DestroyFrameResources();
+	void AllocateInstanceBuffers(FrameResources &frame, u32 capacity);
+	void FreeInstanceBuffers(FrameResources &frame);
+	void ReserveInstances(FrameResources &frame, u32 instanceCount);
 	void CreateDescriptorPool();
 	void CreateDescriptorSets();
+	void WriteInstanceDescriptorSets(FrameResources &frame);
+	void CreateTextureDescriptorSet();
+	void CreateMaterialTable();
 	void CreateCommandBuffers();
+	void CreateTimelineSemaphore();
+	// The GPU is done with every submission up to this value
+	u64 GetCompletedTimelineValue();
+	void WaitForTimelineValue(u64 value);
 	void CreateSyncObjects();
-	void UpdateUniformBuffer(u32 currentImage);
-	void CleanUpSwapChain();
+	void DestroySyncObjects();
+	// Waits until the current frame's resources are free, once per frame
+	void WaitForFrame();
+	void UpdateCamera();
+	void UpdateLods();
+	void UpdateUniformBuffer(FrameResources &frame);
+	void UpdateInstanceBuffer(FrameResources &frame);
+	void FlushFrameResources(FrameResources &frame);
+	void RecordCulling(VkCommandBuffer commandBuffer, FrameResources &frame);
+	bool CanReuseRecordedDraws(const FrameResources &frame) const;
+	// Runs on worker threads, so it only reads engine state and writes to its task
+	void RecordDraws(FrameResources &frame, u32 taskIndex, RecordTask &task);
+	// Draws with the same key can go out in the same multi-draw
+	u64 GetDrawStateKey(const DrawGroup &group) const;
+	u64 GetDrawSortKey(const GraphicComponent &component, u32 pass) const;
+	void RetireSwapChain();
+	// Destroyed once every submission made so far has completed
+	template<typename T>
+	void DeferDestroy(u8 type, T handle)
+	{
+		if (handle != VK_NULL_HANDLE)
+			mDeletionQueue.push_back({ mTimelineValue, reinterpret_cast<u64>(handle), type });
+	}
+	void DeferFreeSlot(u8 type, u32 slot);
+	// Only destroys what the GPU is done with
+	void ProcessDeletionQueue();
 	bool CheckValidationLayerSupport();
 
+	// Largest scale along any axis, for scaling distances and radii
+	static f32 GetMaxScale(const glm::mat4 &transform)
+	{
+		return std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+				glm::length(glm::vec3(transform[2])) });
+	}
+
+	static VkIndexType GetIndexType(u32 indexSize)
+	{
+		return indexSize == sizeof(u16) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	}
+
 	static std::vector<char> ReadFile(const std::string &filename)
 	{
 		std::ifstream file(filename, std::ios::ate | std::ios::binary);
@@ -184,12 +530,17 @@ private:
 	VkQueue mPresentQueue;
 	VkRenderPass mRenderPass;
 	VkPipelineLayout mPipelineLayout;
-	VkPipeline mGraphicsPipeline;
-	VkCommandPool mCommandPool;
-	std::vector<VkCommandBuffer> mCommandBuffers;
+	VkPipelineCache mPipelineCache;
+	// One per vertex layout and set of material features, created the first time they are drawn with
+	std::unordered_map<u32, VkPipeline> mGraphicsPipelines;
+	// Uploads only happen on the main thread, which also owns the queue
+	VkCommandPool mUploadCommandPool;
+	VkCommandBuffer mUploadCommandBuffer;
+	WorkerPool mRecordWorkers;
+	std::vector<RecordTask> mRecordTasks;
 
 	// Swap chain
-	VkSwapchainKHR mSwapChain;
+	VkSwapchainKHR mSwapChain = VK_NULL_HANDLE;
 	std::vector<VkImage> mSwapChainImages;
 	VkFormat mSwapChainImageFormat;
 	VkExtent2D mSwapChainExtent;
@@ -203,22 +554,39 @@ private:
 	VkDeviceMemory mIndexBufferMemory;
 	size_t mIndexCount;
 
+	// Per frame in flight buffers and descriptor sets, they don't depend on the swap chain
+	std::vector<FrameResources> mFrames;
+	// Flushes of non coherent memory are aligned to this
+	VkDeviceSize mNonCoherentAtomSize;
+
 	// Descriptor sets
-	std::vector<VkBuffer> mUniformBuffers;
-	std::vector<VkDeviceMemory> mUniformBuffersMemory;
 	VkDescriptorPool mDescriptorPool;
 	VkDescriptorSetLayout mSceneDescriptorSetLayout;
 	VkDescriptorSetLayout mFrameDescriptorSetLayout;
 	VkDescriptorSetLayout mDrawDescriptorSetLayout;
-	std::vector<VkDescriptorSet> mSceneDescriptorSets;
-	std::vector<VkDescriptorSet> mFrameDescriptorSets;
-	std::vector<VkDescriptorSet> mDrawDescriptorSets;
-
-	// Textures
-	std::vector<VkImage> mTextureImages;
-	std::vector<VkDeviceMemory> mTextureImageMemories;
-	std::vector<VkImageView> mTextureImageViews;
+
+	// Instancing, rebuilt every frame
+	std::vector<DrawGroup> mDrawGroups;
+	// Component of each instance
+	std::vector<u32> mInstanceComponents;
+	// Sort key of each instance
+	std::vector<u64> mInstanceSortKeys;
+	RadixSortScratch mSortScratch;
+
+	// Textures, indexed by slot. Unloaded slots are reused before the table grows.
+	std::vector<Texture> mTextures;
+	std::vector<u32> mFreeTextureSlots;
 	VkSampler mTextureSampler;
+	VkDescriptorSetLayout mTextureDescriptorSetLayout;
+	// Update after bind, so loading a texture doesn't wait for frames in flight
+	VkDescriptorPool mTextureDescriptorPool;
+	VkDescriptorSet mTextureDescriptorSet;
+
+	// Materials, indexed by slot. The GPU copy is bound with the textures, rows are written once when
+	// the material is created. Destroyed slots are reused before the table grows.
+	std::vector<Material> mMaterials;
+	std::vector<u32> mFreeMaterialSlots;
+	MappedBuffer mMaterialBuffer;
 
 	// Depth buffer
 	VkImage mDepthImage;
@@ -228,12 +596,45 @@ private:
 	// Swap chain synchronization
 	std::vector<VkSemaphore> mImageAvailableSemaphores;
 	std::vector<VkSemaphore> mRenderFinishedSemaphores;
-	std::vector<VkFence> mInFlightFences;
-	std::vector<VkFence> mImagesInFlight;
 	size_t mCurrentFrame = 0;
 
+	// Every graphics queue submission signals the next value of the timeline, so anything the GPU
+	// uses can be tagged with the value of its last submission to know when it's free again
+	VkSemaphore mTimelineSemaphore;
+	u64 mTimelineValue = 0;
+	PFN_vkWaitSemaphoresKHR mWaitSemaphores;
+	PFN_vkGetSemaphoreCounterValueKHR mGetSemaphoreCounterValue;
+	// In submission order
+	std::vector<DeferredDestroy> mDeletionQueue;
+
+	// Frame pacing
+	FramePacingSettings mFramePacing;
+	u32 mFramesInFlight;
+	bool mFrameBegun = false;
+	bool mFrameWaited = false;
+	std::chrono::high_resolution_clock::time_point mInputTime;
+	f32 mInputLatencyMs = 0.0f;
+
 	bool mFramebufferResized = false;
 
+	// Camera
+	glm::mat4 mViewMatrix;
+	glm::mat4 mProjMatrix;
+
+	CullingSettings mCulling;
+
+	// GPU culling
+	VkDescriptorSetLayout mCullDescriptorSetLayout;
+	VkPipelineLayout mCullPipelineLayout;
+	VkPipeline mCullPipeline;
+	// Without it every indirect command needs its own call
+	bool mSupportsMultiDrawIndirect = false;
+
+	// CPU culling, rebuilt every frame
+	SphereBoundsSoA mWorldBounds;
+	std::vector<u8> mComponentVisibility;
+	FrameStats mFrameStats = {};
+
 	// Window
 	GLFWwindow *mWindow;
 	VkSurfaceKHR mSurface;
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ArcGlobals.h"
+#include "util/Geometry.h"
+
+// Six inward facing planes extracted from a clip space transform (Gribb & Hartmann), assuming a
+// [0, 1] depth range. Built from a model-view-projection matrix the planes are in object space,
+// which is fine for culling object space bounds as long as the model transform has uniform scale.
+struct Frustum
+{
+	enum EPlanes
+	{
+		PLANE_LEFT,
+		PLANE_RIGHT,
+		PLANE_BOTTOM,
+		PLANE_TOP,
+		PLANE_NEAR,
+		PLANE_FAR,
+		PLANE_COUNT
+	};
+
+	glm::vec4 mPlanes[PLANE_COUNT];
+
+	explicit Frustum(const glm::mat4 &clipTransform)
+	{
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; ++i)
+			rows[i] = glm::vec4(clipTransform[0][i], clipTransform[1][i], clipTransform[2][i], clipTransform[3][i]);
+
+		mPlanes[PLANE_LEFT] = rows[3] + rows[0];
+		mPlanes[PLANE_RIGHT] = rows[3] - rows[0];
+		mPlanes[PLANE_BOTTOM] = rows[3] + rows[1];
+		mPlanes[PLANE_TOP] = rows[3] - rows[1];
+		mPlanes[PLANE_NEAR] = rows[2];
+		mPlanes[PLANE_FAR] = rows[3] - rows[2];
+
+		for (glm::vec4 &plane : mPlanes)
+			plane /= glm::length(glm::vec3(plane));
+	}
+
+	bool IntersectsSphere(const glm::vec3 &center, f32 radius) const
+	{
+		for (const glm::vec4 &plane : mPlanes)
+		{
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+				return false;
+		}
+		return true;
+	}
+};
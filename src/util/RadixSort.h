@@ -0,0 +1,139 @@
+#pragma once
+
+#include "ArcGlobals.h"
+
+#include <emmintrin.h>
+#include <utility>
+#include <vector>
+
+// Buffers the sort ping-pongs through, kept around so sorting every frame doesn't allocate
+struct RadixSortScratch
+{
+	std::vector<u64> mKeys;
+	std::vector<u32> mValues;
+};
+
+// Keys counted side by side, each into its own set of histograms
+static const u32 RADIX_SORT_LANES = 4;
+
+// Stable ascending sort of 64-bit keys, moving values along with them. LSD radix sort on bytes that
+// only counts and sorts the bytes that differ between keys, found up front by OR-ing and AND-ing
+// them all together. Keys that only use some of their bits cost a pass per byte actually in use.
+inline void RadixSort(std::vector<u64> &keys, std::vector<u32> &values, RadixSortScratch &scratch)
+{
+	const u32 count = static_cast<u32>(keys.size());
+	if (count < 2)
+		return;
+
+	// Bits set in some keys but not in all of them, two keys at a time
+	__m128i anyPairBits = _mm_setzero_si128();
+	__m128i allPairBits = _mm_set1_epi32(-1);
+	u32 first = 0;
+	for (; first + 2 <= count; first += 2)
+	{
+		const __m128i keyPair = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&keys[first]));
+		anyPairBits = _mm_or_si128(anyPairBits, keyPair);
+		allPairBits = _mm_and_si128(allPairBits, keyPair);
+	}
+	alignas(16) u64 anyHalves[2];
+	alignas(16) u64 allHalves[2];
+	_mm_store_si128(reinterpret_cast<__m128i *>(anyHalves), anyPairBits);
+	_mm_store_si128(reinterpret_cast<__m128i *>(allHalves), allPairBits);
+	u64 anyBits = anyHalves[0] | anyHalves[1];
+	u64 allBits = allHalves[0] & allHalves[1];
+	if (first < count)
+	{
+		anyBits |= keys[first];
+		allBits &= keys[first];
+	}
+	const u64 varyingBits = anyBits ^ allBits;
+
+	u32 passes[8];
+	u32 passCount = 0;
+	for (u32 pass = 0; pass < 8; ++pass)
+	{
+		if ((varyingBits >> (pass * 8)) & 0xff)
+			passes[passCount++] = pass;
+	}
+	if (passCount == 0)
+		return;
+
+	// Four keys at a time, split into their 32-bit halves so every byte of all four is shifted and
+	// masked out at once. Each key is counted in its lane's histograms: with a single set, keys
+	// sharing a digit would each wait on the previous one's increment.
+	u32 laneHistograms[RADIX_SORT_LANES][8][256] = {};
+	const __m128i byteMask = _mm_set1_epi32(0xff);
+	u32 counted = 0;
+	for (; counted + RADIX_SORT_LANES <= count; counted += RADIX_SORT_LANES)
+	{
+		const __m128 keys01 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&keys[counted])));
+		const __m128 keys23 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&keys[counted + 2])));
+		// Little endian, the low halves are the even elements
+		const __m128i low = _mm_castps_si128(_mm_shuffle_ps(keys01, keys23, _MM_SHUFFLE(2, 0, 2, 0)));
+		const __m128i high = _mm_castps_si128(_mm_shuffle_ps(keys01, keys23, _MM_SHUFFLE(3, 1, 3, 1)));
+
+		alignas(16) u32 digits[8][RADIX_SORT_LANES];
+		_mm_store_si128(reinterpret_cast<__m128i *>(digits[0]), _mm_and_si128(low, byteMask));
+		_mm_store_si128(reinterpret_cast<__m128i *>(digits[1]), _mm_and_si128(_mm_srli_epi32(low, 8), byteMask));
+		_mm_store_si128(reinterpret_cast<__m128i *>(digits[2]), _mm_and_si128(_mm_srli_epi32(low, 16), byteMask));
+		_mm_store_si128(reinterpret_cast<__m128i *>(digits[3]), _mm_srli_epi32(low, 24));
+		_mm_store_si128(reinterpret_cast<__m128i *>(digits[4]), _mm_and_si128(high, byteMask));
+		_mm_store_si128(reinterpret_cast<__m128i *>(digits[5]), _mm_and_si128(_mm_srli_epi32(high, 8), byteMask));
+		_mm_store_si128(reinterpret_cast<__m128i *>(digits[6]), _mm_and_si128(_mm_srli_epi32(high, 16), byteMask));
+		_mm_store_si128(reinterpret_cast<__m128i *>(digits[7]), _mm_srli_epi32(high, 24));
+
+		for (u32 p = 0; p < passCount; ++p)
+		{
+			const u32 pass = passes[p];
+			for (u32 lane = 0; lane < RADIX_SORT_LANES; ++lane)
+				++laneHistograms[lane][pass][digits[pass][lane]];
+		}
+	}
+	for (; counted < count; ++counted)
+	{
+		for (u32 p = 0; p < passCount; ++p)
+			++laneHistograms[0][passes[p]][(keys[counted] >> (passes[p] * 8)) & 0xff];
+	}
+
+	scratch.mKeys.resize(count);
+	scratch.mValues.resize(count);
+	u64 *srcKeys = keys.data();
+	u32 *srcValues = values.data();
+	u64 *dstKeys = scratch.mKeys.data();
+	u32 *dstValues = scratch.mValues.data();
+
+	for (u32 p = 0; p < passCount; ++p)
+	{
+		const u32 pass = passes[p];
+		const u32 shift = pass * 8;
+
+		// Lanes merged and turned into start offsets
+		u32 histogram[256];
+		u32 offset = 0;
+		for (u32 digit = 0; digit < 256; ++digit)
+		{
+			u32 digitCount = 0;
+			for (u32 lane = 0; lane < RADIX_SORT_LANES; ++lane)
+				digitCount += laneHistograms[lane][pass][digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+
+		for (u32 i = 0; i < count; ++i)
+		{
+			const u32 destination = histogram[(srcKeys[i] >> shift) & 0xff]++;
+			dstKeys[destination] = srcKeys[i];
+			dstValues[destination] = srcValues[i];
+		}
+
+		std::swap(srcKeys, dstKeys);
+		std::swap(srcValues, dstValues);
+	}
+
+	// An odd number of passes leaves the result in the scratch buffers
+	if (srcKeys != keys.data())
+	{
+		keys.swap(scratch.mKeys);
+		values.swap(scratch.mValues);
+	}
+}
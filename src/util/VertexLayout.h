@@ -0,0 +1,162 @@
+#pragma once
+
+#include "ArcGlobals.h"
+
+#include <vector>
+
+enum PositionFormat : u8
+{
+	POSITIONFORMAT_FLOAT3,
+	// Relative to the mesh center, w unused
+	POSITIONFORMAT_HALF4,
+	// Normalized to the mesh bounds, w unused
+	POSITIONFORMAT_UNORM16X4
+};
+
+enum ColorFormat : u8
+{
+	// Same color on every vertex, read from a stride 0 binding instead
+	COLORFORMAT_CONSTANT,
+	COLORFORMAT_FLOAT3,
+	COLORFORMAT_UNORM8X4
+};
+
+enum TexCoordFormat : u8
+{
+	TEXCOORDFORMAT_FLOAT2,
+	// Only used when every coordinate is in [0, 1]
+	TEXCOORDFORMAT_UNORM16X2
+};
+
+// Vertex formats chosen per mesh at bake time. Positions live in their own stream so passes that
+// only need them don't fetch the rest; color and texture coordinates follow, in this order, in the
+// attribute stream.
+struct VertexLayout
+{
+	u8 mPositionFormat;
+	u8 mColorFormat;
+	u8 mTexCoordFormat;
+	u8 mPadding;
+
+	enum EBindings
+	{
+		BINDING_POSITION,
+		BINDING_ATTRIBUTE,
+		BINDING_CONSTANT,
+		BINDING_COUNT
+	};
+
+	static u32 GetPositionSize(u8 format)
+	{
+		return format == POSITIONFORMAT_FLOAT3 ? 3 * sizeof(f32) : 4 * sizeof(u16);
+	}
+
+	static u32 GetColorSize(u8 format)
+	{
+		switch (format)
+		{
+			case COLORFORMAT_FLOAT3: return 3 * sizeof(f32);
+			case COLORFORMAT_UNORM8X4: return 4 * sizeof(u8);
+		}
+		return 0;
+	}
+
+	static u32 GetTexCoordSize(u8 format)
+	{
+		return format == TEXCOORDFORMAT_FLOAT2 ? 2 * sizeof(f32) : 2 * sizeof(u16);
+	}
+
+	// Bits used by GetCompactKey
+	static const u32 COMPACT_KEY_BITS = 5;
+
+	u32 GetKey() const
+	{
+		return mPositionFormat | (mColorFormat << 8) | (mTexCoordFormat << 16);
+	}
+
+	// Same information in COMPACT_KEY_BITS bits, for sort keys
+	u32 GetCompactKey() const
+	{
+		return mPositionFormat | (mColorFormat << 2) | (mTexCoordFormat << 4);
+	}
+
+	u32 GetPositionStride() const { return GetPositionSize(mPositionFormat); }
+	u32 GetColorOffset() const { return 0; }
+	u32 GetTexCoordOffset() const { return GetColorOffset() + GetColorSize(mColorFormat); }
+	u32 GetAttributeStride() const { return GetTexCoordOffset() + GetTexCoordSize(mTexCoordFormat); }
+	// Bytes per vertex across both streams
+	u32 GetStride() const { return GetPositionStride() + GetAttributeStride(); }
+
+	bool HasConstantAttributes() const { return mColorFormat == COLORFORMAT_CONSTANT; }
+
+#ifndef ARC_TOOLS
+	std::vector<VkVertexInputBindingDescription> GetBindingDescriptions() const
+	{
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+		bindingDescriptions[0].binding = BINDING_POSITION;
+		bindingDescriptions[0].stride = GetPositionStride();
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		VkVertexInputBindingDescription attributeBinding = {};
+		attributeBinding.binding = BINDING_ATTRIBUTE;
+		attributeBinding.stride = GetAttributeStride();
+		attributeBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		bindingDescriptions.push_back(attributeBinding);
+
+		if (HasConstantAttributes())
+		{
+			// Stride 0: every vertex reads the same value
+			VkVertexInputBindingDescription constantBinding = {};
+			constantBinding.binding = BINDING_CONSTANT;
+			constantBinding.stride = 0;
+			constantBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+			bindingDescriptions.push_back(constantBinding);
+		}
+
+		return bindingDescriptions;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions() const
+	{
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(3);
+
+		attributeDescriptions[0].binding = BINDING_POSITION;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].offset = 0;
+		switch (mPositionFormat)
+		{
+			case POSITIONFORMAT_FLOAT3: attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT; break;
+			case POSITIONFORMAT_HALF4: attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SFLOAT; break;
+			case POSITIONFORMAT_UNORM16X4: attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM; break;
+		}
+
+		attributeDescriptions[1].location = 1;
+		switch (mColorFormat)
+		{
+			case COLORFORMAT_CONSTANT:
+				attributeDescriptions[1].binding = BINDING_CONSTANT;
+				attributeDescriptions[1].offset = 0;
+				attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+				break;
+			case COLORFORMAT_FLOAT3:
+				attributeDescriptions[1].binding = BINDING_ATTRIBUTE;
+				attributeDescriptions[1].offset = GetColorOffset();
+				attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+				break;
+			case COLORFORMAT_UNORM8X4:
+				attributeDescriptions[1].binding = BINDING_ATTRIBUTE;
+				attributeDescriptions[1].offset = GetColorOffset();
+				attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+				break;
+		}
+
+		attributeDescriptions[2].binding = BINDING_ATTRIBUTE;
+		attributeDescriptions[2].location = 2;
+		attributeDescriptions[2].offset = GetTexCoordOffset();
+		attributeDescriptions[2].format = mTexCoordFormat == TEXCOORDFORMAT_FLOAT2 ?
+			VK_FORMAT_R32G32_SFLOAT : VK_FORMAT_R16G16_UNORM;
+
+		return attributeDescriptions;
+	}
+#endif
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "ArcGlobals.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads kept around for jobs split into tasks that run every frame, where spawning threads each
+// time would cost more than the work saved. The calling thread takes part in every job.
+class WorkerPool
+{
+	ARC_DISABLE_COPY(WorkerPool);
+
+public:
+	WorkerPool() = default;
+
+	// Thread count includes the calling thread
+	void Start(u32 threadCount)
+	{
+		ARC_ASSERT(mThreads.empty() && threadCount > 0);
+		mStop = false;
+		mThreads.reserve(threadCount - 1);
+		for (u32 i = 0; i + 1 < threadCount; ++i)
+			mThreads.emplace_back([this] { WorkerLoop(); });
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = true;
+		}
+		mWorkReady.notify_all();
+		for (std::thread &thread : mThreads)
+			thread.join();
+		mThreads.clear();
+	}
+
+	u32 GetThreadCount() const { return static_cast<u32>(mThreads.size()) + 1; }
+
+	// Runs job(taskIndex) for every task and returns once all of them are done. Tasks are handed out
+	// in order but may run on any thread.
+	template<typename Job>
+	void Run(u32 taskCount, const Job &job)
+	{
+		{
+			// Workers still looking at the previous job would see this one half written
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWorkDone.wait(lock, [this] { return mActiveWorkers == 0; });
+
+			mJob = &job;
+			mInvoke = [](const void *job, u32 task) { (*static_cast<const Job *>(job))(task); };
+			mTaskCount = taskCount;
+			mNextTask = 0;
+			++mGeneration;
+		}
+		mWorkReady.notify_all();
+
+		RunTasks();
+
+		// Every task has been picked up, wait for the ones still running elsewhere
+		std::unique_lock<std::mutex> lock(mMutex);
+		mWorkDone.wait(lock, [this] { return mActiveWorkers == 0; });
+	}
+
+private:
+	void RunTasks()
+	{
+		for (;;)
+		{
+			const u32 task = mNextTask.fetch_add(1);
+			if (task >= mTaskCount)
+				return;
+			mInvoke(mJob, task);
+		}
+	}
+
+	void WorkerLoop()
+	{
+		u64 generation = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mWorkReady.wait(lock, [&] { return mStop || mGeneration != generation; });
+				if (mStop)
+					return;
+				generation = mGeneration;
+				++mActiveWorkers;
+			}
+
+			RunTasks();
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				--mActiveWorkers;
+			}
+			mWorkDone.notify_all();
+		}
+	}
+
+	std::vector<std::thread> mThreads;
+	std::mutex mMutex;
+	std::condition_variable mWorkReady;
+	std::condition_variable mWorkDone;
+	bool mStop = false;
+	u64 mGeneration = 0;
+	u32 mActiveWorkers = 0;
+
+	// Only written while no worker is active
+	const void *mJob = nullptr;
+	void (*mInvoke)(const void *job, u32 task) = nullptr;
+	u32 mTaskCount = 0;
+	std::atomic<u32> mNextTask { 0 };
+};
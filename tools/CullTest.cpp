@@ -0,0 +1,492 @@
+// Runs shaders/cull.spv on its own, without a window or swap chain, and checks the indirect commands,
+// visible instances and stats it writes against the CPU culling path. Uses the first device the loader
+// finds, so it runs on a software driver by pointing VK_ICD_FILENAMES at lavapipe's lvp_icd json.
+// Run from the repository root. Returns non-zero on any mismatch.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "ArcGlobals.h"
+#include "render/Culling.h"
+#include "util/Frustum.h"
+
+// Same layouts as VulkanEngine, shared with shaders/cull.comp
+struct CullObject
+{
+	alignas(16) glm::mat4 model;
+	// Object space center and radius
+	alignas(16) glm::vec4 boundingSphere;
+};
+
+struct CullPushConstants
+{
+	glm::vec4 frustumPlanes[Frustum::PLANE_COUNT];
+};
+
+struct CullStats
+{
+	u32 visibleCount;
+	u32 triangleCount;
+};
+
+// Instances per draw group, around the shader's chunks of 64
+static const u32 GROUP_SIZES[] = { 0, 1, 2, 63, 64, 65, 128, 200, 1000, 4097 };
+
+// Objects closer than this to a plane could land on either side depending on rounding
+static const f32 PLANE_MARGIN = 1e-3f;
+
+struct HostBuffer
+{
+	VkBuffer mBuffer;
+	VkDeviceMemory mMemory;
+	void *mData;
+};
+
+struct Scene
+{
+	std::vector<CullObject> mObjects;
+	// Only the first instance and index count are filled in, the rest is up to the culling
+	std::vector<VkDrawIndexedIndirectCommand> mCommands;
+	Frustum mFrustum;
+};
+
+static bool ReadFile(const char *filename, std::vector<u32> &code)
+{
+	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	const size_t size = static_cast<size_t>(file.tellg());
+	code.resize(size / sizeof(u32));
+	file.seekg(0);
+	file.read(reinterpret_cast<char *>(code.data()), size);
+	return true;
+}
+
+static f32 GetMaxScale(const glm::mat4 &transform)
+{
+	return std::max(std::max(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1]))),
+			glm::length(glm::vec3(transform[2])));
+}
+
+static glm::vec3 GetWorldCenter(const CullObject &object)
+{
+	return glm::vec3(object.model * glm::vec4(glm::vec3(object.boundingSphere), 1.0f));
+}
+
+// Draw groups of random objects around the camera, each group sorted nearest first like the engine's
+static Scene CreateScene()
+{
+	const glm::mat4 view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	const glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 40.0f);
+	Scene scene = { {}, {}, Frustum(proj * view) };
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<f32> position(-30.0f, 30.0f);
+	std::uniform_real_distribution<f32> scale(0.2f, 2.0f);
+	std::uniform_real_distribution<f32> radius(0.1f, 3.0f);
+
+	for (u32 groupSize : GROUP_SIZES)
+	{
+		VkDrawIndexedIndirectCommand command = {};
+		command.indexCount = 3 * (static_cast<u32>(scene.mCommands.size()) + 1);
+		command.firstInstance = static_cast<u32>(scene.mObjects.size());
+		scene.mCommands.push_back(command);
+
+		std::vector<CullObject> group;
+		while (group.size() < groupSize)
+		{
+			CullObject object;
+			const glm::vec3 translation(position(random), position(random), position(random));
+			object.model = glm::scale(glm::translate(glm::mat4(1.0f), translation),
+					glm::vec3(scale(random), scale(random), scale(random)));
+			object.boundingSphere = glm::vec4(0.5f, -0.25f, 0.0f, radius(random));
+
+			const glm::vec3 center = GetWorldCenter(object);
+			const f32 worldRadius = object.boundingSphere.w * GetMaxScale(object.model);
+			bool ambiguous = false;
+			for (const glm::vec4 &plane : scene.mFrustum.mPlanes)
+				ambiguous |= std::abs(glm::dot(glm::vec3(plane), center) + plane.w + worldRadius) < PLANE_MARGIN;
+			if (!ambiguous)
+				group.push_back(object);
+		}
+
+		std::sort(group.begin(), group.end(), [&](const CullObject &a, const CullObject &b)
+		{
+			return (view * glm::vec4(GetWorldCenter(a), 1.0f)).z > (view * glm::vec4(GetWorldCenter(b), 1.0f)).z;
+		});
+		scene.mObjects.insert(scene.mObjects.end(), group.begin(), group.end());
+	}
+
+	return scene;
+}
+
+static HostBuffer CreateHostBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size,
+		VkBufferUsageFlags usage)
+{
+	HostBuffer buffer = {};
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VK_ASSERT(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer.mBuffer));
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(device, buffer.mBuffer, &memRequirements);
+
+	// Coherent, so results can be read right after the fence without invalidating
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+	const VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	u32 memoryType = UINT32_MAX;
+	for (u32 i = 0; i < memProperties.memoryTypeCount && memoryType == UINT32_MAX; ++i)
+	{
+		if (memRequirements.memoryTypeBits & (1 << i) &&
+				(memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			memoryType = i;
+	}
+	ARC_ASSERT(memoryType != UINT32_MAX);
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = memoryType;
+	VK_ASSERT(vkAllocateMemory(device, &allocInfo, nullptr, &buffer.mMemory));
+	VK_ASSERT(vkBindBufferMemory(device, buffer.mBuffer, buffer.mMemory, 0));
+	VK_ASSERT(vkMapMemory(device, buffer.mMemory, 0, VK_WHOLE_SIZE, 0, &buffer.mData));
+
+	return buffer;
+}
+
+static void DestroyHostBuffer(VkDevice device, HostBuffer &buffer)
+{
+	// Freeing the memory unmaps it
+	vkDestroyBuffer(device, buffer.mBuffer, nullptr);
+	vkFreeMemory(device, buffer.mMemory, nullptr);
+}
+
+// Returns the number of mismatches, reporting the first few of them
+static u32 CheckResults(const Scene &scene, const VkDrawIndexedIndirectCommand *commands,
+		const u32 *instanceIndices, const CullStats &stats)
+{
+	SphereBoundsSoA spheres;
+	for (const CullObject &object : scene.mObjects)
+		spheres.Add(GetWorldCenter(object), object.boundingSphere.w * GetMaxScale(object.model));
+	std::vector<u8> visibility;
+	CullSpheres(scene.mFrustum, spheres, visibility);
+
+	u32 errorCount = 0;
+	auto report = [&](const char *what, u32 groupIndex, u32 expected, u32 actual)
+	{
+		if (errorCount++ < 16)
+			std::cout << "  Group " << groupIndex << ": " << what << " " << actual << ", expected " << expected <<
+					std::endl;
+	};
+
+	CullStats expectedStats = {};
+	for (u32 groupIndex = 0; groupIndex < scene.mCommands.size(); ++groupIndex)
+	{
+		const VkDrawIndexedIndirectCommand &expected = scene.mCommands[groupIndex];
+		const VkDrawIndexedIndirectCommand &actual = commands[groupIndex];
+
+		// Visible instances in their sorted order, packed at the start of the group's range
+		u32 visibleCount = 0;
+		for (u32 i = expected.firstInstance; i < expected.firstInstance + GROUP_SIZES[groupIndex]; ++i)
+		{
+			if (!visibility[i])
+				continue;
+			const u32 slot = expected.firstInstance + visibleCount++;
+			if (visibleCount <= actual.instanceCount && instanceIndices[slot] != i)
+				report("instance index", groupIndex, i, instanceIndices[slot]);
+		}
+
+		if (actual.instanceCount != visibleCount)
+			report("instance count", groupIndex, visibleCount, actual.instanceCount);
+		if (actual.indexCount != expected.indexCount)
+			report("index count", groupIndex, expected.indexCount, actual.indexCount);
+		if (actual.firstInstance != expected.firstInstance)
+			report("first instance", groupIndex, expected.firstInstance, actual.firstInstance);
+
+		std::cout << "  Group " << groupIndex << ": " << visibleCount << " of " << GROUP_SIZES[groupIndex] <<
+				" visible" << std::endl;
+		expectedStats.visibleCount += visibleCount;
+		expectedStats.triangleCount += visibleCount * (expected.indexCount / 3);
+	}
+
+	if (stats.visibleCount != expectedStats.visibleCount)
+		report("stats visible count", 0, expectedStats.visibleCount, stats.visibleCount);
+	if (stats.triangleCount != expectedStats.triangleCount)
+		report("stats triangle count", 0, expectedStats.triangleCount, stats.triangleCount);
+
+	return errorCount;
+}
+
+int main(int argc, char **argv)
+{
+	const char *shaderFilename = argc > 1 ? argv[1] : "shaders/cull.spv";
+	std::vector<u32> shaderCode;
+	if (!ReadFile(shaderFilename, shaderCode))
+	{
+		std::cout << "Can't read " << shaderFilename << std::endl;
+		return 1;
+	}
+
+	VkApplicationInfo appInfo = {};
+	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.pApplicationName = "CullTest";
+	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+	appInfo.pEngineName = "Arc03";
+	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+	// Nothing past 1.0 is needed, so software drivers that stop there still run it
+	appInfo.apiVersion = VK_API_VERSION_1_0;
+
+	VkInstanceCreateInfo instanceInfo = {};
+	instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	instanceInfo.pApplicationInfo = &appInfo;
+
+	VkInstance instance;
+	VK_ASSERT(vkCreateInstance(&instanceInfo, nullptr, &instance));
+
+	u32 deviceCount = 0;
+	vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+	std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
+	vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data());
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	u32 queueFamily = UINT32_MAX;
+	for (u32 i = 0; i < deviceCount && physicalDevice == VK_NULL_HANDLE; ++i)
+	{
+		u32 familyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevices[i], &familyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> families(familyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevices[i], &familyCount, families.data());
+		for (u32 family = 0; family < familyCount && physicalDevice == VK_NULL_HANDLE; ++family)
+		{
+			if (families[family].queueFlags & VK_QUEUE_COMPUTE_BIT)
+			{
+				physicalDevice = physicalDevices[i];
+				queueFamily = family;
+			}
+		}
+	}
+	if (physicalDevice == VK_NULL_HANDLE)
+	{
+		std::cout << "No device with a compute queue" << std::endl;
+		vkDestroyInstance(instance, nullptr);
+		return 1;
+	}
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	std::cout << "Device: " << deviceProperties.deviceName << std::endl;
+
+	const f32 queuePriority = 1.0f;
+	VkDeviceQueueCreateInfo queueInfo = {};
+	queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queueInfo.queueFamilyIndex = queueFamily;
+	queueInfo.queueCount = 1;
+	queueInfo.pQueuePriorities = &queuePriority;
+
+	VkDeviceCreateInfo deviceInfo = {};
+	deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceInfo.queueCreateInfoCount = 1;
+	deviceInfo.pQueueCreateInfos = &queueInfo;
+
+	VkDevice device;
+	VK_ASSERT(vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device));
+	VkQueue queue;
+	vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+	// Buffers as the engine fills them: objects and commands by the CPU, stats cleared
+	const Scene scene = CreateScene();
+	const u32 objectCount = static_cast<u32>(scene.mObjects.size());
+	const u32 groupCount = static_cast<u32>(scene.mCommands.size());
+
+	HostBuffer objectBuffer = CreateHostBuffer(physicalDevice, device, sizeof(CullObject) * objectCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	memcpy(objectBuffer.mData, scene.mObjects.data(), sizeof(CullObject) * objectCount);
+
+	HostBuffer commandBuffer = CreateHostBuffer(physicalDevice, device, sizeof(VkDrawIndexedIndirectCommand) *
+			groupCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+	VkDrawIndexedIndirectCommand *commands = static_cast<VkDrawIndexedIndirectCommand *>(commandBuffer.mData);
+	for (u32 i = 0; i < groupCount; ++i)
+	{
+		commands[i] = scene.mCommands[i];
+		commands[i].instanceCount = GROUP_SIZES[i];
+	}
+
+	HostBuffer statsBuffer = CreateHostBuffer(physicalDevice, device, sizeof(CullStats),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	memset(statsBuffer.mData, 0, sizeof(CullStats));
+
+	// Filled with a value no instance has, so missing writes show up
+	HostBuffer instanceIndexBuffer = CreateHostBuffer(physicalDevice, device, sizeof(u32) * objectCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	memset(instanceIndexBuffer.mData, 0xff, sizeof(u32) * objectCount);
+
+	// Same bindings as the engine's culling set
+	HostBuffer *buffers[] = { &objectBuffer, &commandBuffer, &statsBuffer, &instanceIndexBuffer };
+	const u32 bindingCount = 4;
+
+	VkDescriptorSetLayoutBinding bindings[bindingCount] = {};
+	for (u32 i = 0; i < bindingCount; ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = bindingCount;
+	layoutInfo.pBindings = bindings;
+	VkDescriptorSetLayout setLayout;
+	VK_ASSERT(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout));
+
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = bindingCount;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	VkDescriptorPool descriptorPool;
+	VK_ASSERT(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool));
+
+	VkDescriptorSetAllocateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setInfo.descriptorPool = descriptorPool;
+	setInfo.descriptorSetCount = 1;
+	setInfo.pSetLayouts = &setLayout;
+	VkDescriptorSet descriptorSet;
+	VK_ASSERT(vkAllocateDescriptorSets(device, &setInfo, &descriptorSet));
+
+	VkDescriptorBufferInfo bufferInfos[bindingCount] = {};
+	VkWriteDescriptorSet descriptorWrites[bindingCount] = {};
+	for (u32 i = 0; i < bindingCount; ++i)
+	{
+		bufferInfos[i].buffer = buffers[i]->mBuffer;
+		bufferInfos[i].offset = 0;
+		bufferInfos[i].range = VK_WHOLE_SIZE;
+
+		descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[i].dstSet = descriptorSet;
+		descriptorWrites[i].dstBinding = i;
+		descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[i].descriptorCount = 1;
+		descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+	}
+	vkUpdateDescriptorSets(device, bindingCount, descriptorWrites, 0, nullptr);
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(CullPushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	VkPipelineLayout pipelineLayout;
+	VK_ASSERT(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+
+	VkShaderModuleCreateInfo moduleInfo = {};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = shaderCode.size() * sizeof(u32);
+	moduleInfo.pCode = shaderCode.data();
+	VkShaderModule shaderModule;
+	VK_ASSERT(vkCreateShaderModule(device, &moduleInfo, nullptr, &shaderModule));
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = pipelineLayout;
+	VkPipeline pipeline;
+	VK_ASSERT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
+
+	VkCommandPoolCreateInfo commandPoolInfo = {};
+	commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolInfo.queueFamilyIndex = queueFamily;
+	VkCommandPool commandPool;
+	VK_ASSERT(vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool));
+
+	VkCommandBufferAllocateInfo commandBufferInfo = {};
+	commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferInfo.commandPool = commandPool;
+	commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferInfo.commandBufferCount = 1;
+	VkCommandBuffer cmd;
+	VK_ASSERT(vkAllocateCommandBuffers(device, &commandBufferInfo, &cmd));
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VK_ASSERT(vkBeginCommandBuffer(cmd, &beginInfo));
+
+	CullPushConstants pushConstants = {};
+	for (int i = 0; i < Frustum::PLANE_COUNT; ++i)
+		pushConstants.frustumPlanes[i] = scene.mFrustum.mPlanes[i];
+
+	// Recorded like VulkanEngine::RecordCulling, one workgroup per draw group
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+	vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants),
+			&pushConstants);
+	vkCmdDispatch(cmd, groupCount, 1, 1);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0,
+			nullptr, 0, nullptr);
+	VK_ASSERT(vkEndCommandBuffer(cmd));
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	VkFence fence;
+	VK_ASSERT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmd;
+	VK_ASSERT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+	VK_ASSERT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+
+	const u32 errorCount = CheckResults(scene, commands, static_cast<const u32 *>(instanceIndexBuffer.mData),
+			*static_cast<const CullStats *>(statsBuffer.mData));
+	std::cout << (errorCount == 0 ? "Passed" : "Failed") << ": " << objectCount << " objects in " << groupCount <<
+			" draw groups, " << errorCount << " mismatches" << std::endl;
+
+	vkDestroyFence(device, fence, nullptr);
+	vkDestroyCommandPool(device, commandPool, nullptr);
+	vkDestroyPipeline(device, pipeline, nullptr);
+	vkDestroyShaderModule(device, shaderModule, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	for (HostBuffer *buffer : buffers)
+		DestroyHostBuffer(device, *buffer);
+	vkDestroyDevice(device, nullptr);
+	vkDestroyInstance(instance, nullptr);
+
+	return errorCount == 0 ? 0 : 1;
+}
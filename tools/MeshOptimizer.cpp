@@ -0,0 +1,364 @@
+#define ARC_TOOLS
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const u32 FORSYTH_CACHE_SIZE = 32;
+	const f32 FORSYTH_CACHE_DECAY_POWER = 1.5f;
+	const f32 FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+	const f32 FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+	const f32 FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+	// Cache size used to place cluster boundaries, matches what AnalyzeVertexCache reports by default
+	const u32 OVERDRAW_CACHE_SIZE = 16;
+
+	f32 ForsythVertexScore(s32 cachePosition, u32 liveTriangles)
+	{
+		if (liveTriangles == 0)
+			return -1.0f;
+
+		f32 score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			// The vertices of the last triangle get a fixed score so the next one doesn't just reuse
+			// the same edge over and over
+			if (cachePosition < 3)
+			{
+				score = FORSYTH_LAST_TRIANGLE_SCORE;
+			}
+			else
+			{
+				const f32 scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+				score = powf(1.0f - (cachePosition - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+			}
+		}
+
+		// Favour vertices with few triangles left so they don't end up as lone stragglers
+		score += FORSYTH_VALENCE_BOOST_SCALE * powf(static_cast<f32>(liveTriangles),
+				-FORSYTH_VALENCE_BOOST_POWER);
+		return score;
+	}
+
+	// FIFO cache simulation shared by the analysis and the overdraw clustering. A vertex is cached if
+	// it was last transformed less than cacheSize misses ago.
+	class FifoCache
+	{
+		std::vector<u32> mTimestamps;
+		u32 mCacheSize;
+		u32 mTimestamp;
+
+	public:
+		FifoCache(u32 vertexCount, u32 cacheSize)
+			: mTimestamps(vertexCount, 0)
+			, mCacheSize(cacheSize)
+			, mTimestamp(cacheSize + 1)
+		{}
+
+		u32 Access(u32 vertex)
+		{
+			if (mTimestamp - mTimestamps[vertex] > mCacheSize)
+			{
+				mTimestamps[vertex] = mTimestamp++;
+				return 1;
+			}
+			return 0;
+		}
+
+		u32 AccessTriangle(const u32 *triangle)
+		{
+			return Access(triangle[0]) + Access(triangle[1]) + Access(triangle[2]);
+		}
+
+		void Flush()
+		{
+			mTimestamp += mCacheSize + 1;
+		}
+	};
+}
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<u32> &indices, u32 vertexCount, u32 cacheSize)
+{
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+
+	u32 misses = 0;
+	u32 referencedCount = 0;
+	for (const u32 index : indices)
+	{
+		misses += cache.Access(index);
+		if (!referenced[index])
+		{
+			referenced[index] = true;
+			++referencedCount;
+		}
+	}
+
+	VertexCacheStats stats;
+	stats.mAcmr = indices.empty() ? 0.0f : static_cast<f32>(misses) / (indices.size() / 3);
+	stats.mAtvr = referencedCount == 0 ? 0.0f : static_cast<f32>(misses) / referencedCount;
+	return stats;
+}
+
+void OptimizeVertexCache(std::vector<u32> &indices, u32 vertexCount)
+{
+	const u32 triangleCount = static_cast<u32>(indices.size() / 3);
+	if (triangleCount == 0)
+		return;
+
+	// Vertex to triangle adjacency. The first liveTriangles[v] entries of each list are the triangles
+	// not emitted yet.
+	std::vector<u32> liveTriangles(vertexCount, 0);
+	for (const u32 index : indices)
+		++liveTriangles[index];
+
+	std::vector<u32> adjacencyOffsets(vertexCount + 1, 0);
+	for (u32 v = 0; v < vertexCount; ++v)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+	std::vector<u32> adjacency(indices.size());
+	{
+		std::vector<u32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (u32 i = 0; i < indices.size(); ++i)
+			adjacency[fill[indices[i]]++] = i / 3;
+	}
+
+	std::vector<f32> vertexScores(vertexCount);
+	for (u32 v = 0; v < vertexCount; ++v)
+		vertexScores[v] = ForsythVertexScore(-1, liveTriangles[v]);
+
+	std::vector<f32> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	u32 bestTriangle = 0;
+	for (u32 t = 0; t < triangleCount; ++t)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3 + 0]] + vertexScores[indices[t * 3 + 1]] +
+			vertexScores[indices[t * 3 + 2]];
+		if (triangleScores[t] > triangleScores[bestTriangle])
+			bestTriangle = t;
+	}
+
+	std::vector<u32> result;
+	result.reserve(indices.size());
+
+	u32 cache[FORSYTH_CACHE_SIZE + 3];
+	u32 newCache[FORSYTH_CACHE_SIZE + 3];
+	u32 cacheCount = 0;
+	u32 scanCursor = 0;
+
+	for (u32 emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+	{
+		if (bestTriangle == UINT32_MAX)
+		{
+			// Nothing in the cache has triangles left, carry on from wherever we haven't been yet
+			while (emitted[scanCursor])
+				++scanCursor;
+			bestTriangle = scanCursor;
+		}
+
+		const u32 *triangle = &indices[bestTriangle * 3];
+		result.insert(result.end(), triangle, triangle + 3);
+		emitted[bestTriangle] = true;
+
+		u32 newCount = 0;
+		for (u32 k = 0; k < 3; ++k)
+		{
+			const u32 v = triangle[k];
+
+			// Remove the triangle from the live part of the vertex's list
+			u32 *list = &adjacency[adjacencyOffsets[v]];
+			const u32 liveCount = liveTriangles[v];
+			for (u32 i = 0; i < liveCount; ++i)
+			{
+				if (list[i] == bestTriangle)
+				{
+					std::swap(list[i], list[liveCount - 1]);
+					break;
+				}
+			}
+			--liveTriangles[v];
+
+			// Degenerate triangles can repeat a vertex
+			if (std::find(newCache, newCache + newCount, v) == newCache + newCount)
+				newCache[newCount++] = v;
+		}
+
+		// Most recently used go first, anything past the cache size gets evicted
+		for (u32 i = 0; i < cacheCount; ++i)
+		{
+			const u32 v = cache[i];
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				newCache[newCount++] = v;
+		}
+
+		for (u32 i = 0; i < newCount; ++i)
+		{
+			const u32 v = newCache[i];
+			const s32 position = i < FORSYTH_CACHE_SIZE ? static_cast<s32>(i) : -1;
+
+			const f32 score = ForsythVertexScore(position, liveTriangles[v]);
+			const f32 delta = score - vertexScores[v];
+			vertexScores[v] = score;
+
+			const u32 *list = &adjacency[adjacencyOffsets[v]];
+			for (u32 j = 0; j < liveTriangles[v]; ++j)
+				triangleScores[list[j]] += delta;
+		}
+
+		cacheCount = std::min(newCount, FORSYTH_CACHE_SIZE);
+		std::copy(newCache, newCache + cacheCount, cache);
+
+		// Only triangles touching the cache could have become the best one
+		bestTriangle = UINT32_MAX;
+		f32 bestScore = -1.0f;
+		for (u32 i = 0; i < cacheCount; ++i)
+		{
+			const u32 v = cache[i];
+			const u32 *list = &adjacency[adjacencyOffsets[v]];
+			for (u32 j = 0; j < liveTriangles[v]; ++j)
+			{
+				if (triangleScores[list[j]] > bestScore)
+				{
+					bestScore = triangleScores[list[j]];
+					bestTriangle = list[j];
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+void OptimizeOverdraw(std::vector<u32> &indices, const std::vector<Vertex> &vertices, f32 threshold)
+{
+	const u32 triangleCount = static_cast<u32>(indices.size() / 3);
+	if (triangleCount == 0)
+		return;
+
+	FifoCache cache(static_cast<u32>(vertices.size()), OVERDRAW_CACHE_SIZE);
+
+	// Hard boundaries: triangles that miss all three vertices, where the cache optimizer had to jump
+	// somewhere else. Reordering at these points costs nothing.
+	std::vector<u32> hardBoundaries;
+	for (u32 t = 0; t < triangleCount; ++t)
+	{
+		if (cache.AccessTriangle(&indices[t * 3]) == 3 || t == 0)
+			hardBoundaries.push_back(t);
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// Soft boundaries: split further wherever the cluster so far stays within the threshold of the
+	// ACMR of the whole hard cluster, assuming the cache is flushed at the split.
+	std::vector<u32> clusterStarts;
+	for (size_t h = 0; h + 1 < hardBoundaries.size(); ++h)
+	{
+		const u32 start = hardBoundaries[h];
+		const u32 end = hardBoundaries[h + 1];
+
+		cache.Flush();
+		u32 hardMisses = 0;
+		for (u32 t = start; t < end; ++t)
+			hardMisses += cache.AccessTriangle(&indices[t * 3]);
+		const f32 maxAcmr = threshold * hardMisses / (end - start);
+
+		cache.Flush();
+		u32 clusterStart = start;
+		u32 clusterMisses = 0;
+		clusterStarts.push_back(start);
+		for (u32 t = start; t + 1 < end; ++t)
+		{
+			clusterMisses += cache.AccessTriangle(&indices[t * 3]);
+			if (static_cast<f32>(clusterMisses) / (t + 1 - clusterStart) <= maxAcmr)
+			{
+				cache.Flush();
+				clusterStart = t + 1;
+				clusterMisses = 0;
+				clusterStarts.push_back(clusterStart);
+			}
+		}
+	}
+	clusterStarts.push_back(triangleCount);
+
+	// Clusters facing away from the middle of the mesh tend to occlude the rest, draw those first
+	struct Cluster
+	{
+		u32 mStart;
+		u32 mEnd;
+		f32 mSortKey;
+	};
+	std::vector<Cluster> clusters(clusterStarts.size() - 1);
+	std::vector<glm::vec3> centroids(clusters.size());
+	std::vector<glm::vec3> normals(clusters.size());
+
+	glm::vec3 meshCentroid(0.0f);
+	f32 meshArea = 0.0f;
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		clusters[c].mStart = clusterStarts[c];
+		clusters[c].mEnd = clusterStarts[c + 1];
+
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		f32 area = 0.0f;
+		for (u32 t = clusters[c].mStart; t < clusters[c].mEnd; ++t)
+		{
+			const glm::vec3 &p0 = vertices[indices[t * 3 + 0]].pos;
+			const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].pos;
+			const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].pos;
+			const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			const f32 triangleArea = glm::length(n);
+
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += n;
+			area += triangleArea;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+		centroids[c] = area > 0.0f ? centroid / area : vertices[indices[clusters[c].mStart * 3]].pos;
+		normals[c] = normal;
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		const f32 normalLength = glm::length(normals[c]);
+		clusters[c].mSortKey = normalLength > 0.0f ?
+			glm::dot(centroids[c] - meshCentroid, normals[c] / normalLength) : 0.0f;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b)
+	{
+		return a.mSortKey > b.mSortKey;
+	});
+
+	std::vector<u32> result;
+	result.reserve(indices.size());
+	for (const Cluster &cluster : clusters)
+		result.insert(result.end(), indices.begin() + cluster.mStart * 3, indices.begin() + cluster.mEnd * 3);
+
+	indices.swap(result);
+}
+
+void OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<u32> &indices)
+{
+	std::vector<u32> remap(vertices.size(), UINT32_MAX);
+	std::vector<Vertex> result;
+	result.reserve(vertices.size());
+
+	for (u32 &index : indices)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = static_cast<u32>(result.size());
+			result.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(result);
+}
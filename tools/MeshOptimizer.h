@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ArcGlobals.h"
+#include "util/Geometry.h"
+
+#include <vector>
+
+struct VertexCacheStats
+{
+	// Average cache miss ratio: transformed vertices per triangle. 0.5 is the best possible on a
+	// regular grid, 3 means no reuse at all.
+	f32 mAcmr;
+	// Average transform to vertex ratio: transformed vertices per referenced vertex. 1 is optimal.
+	f32 mAtvr;
+};
+
+// Simulates a FIFO post-transform cache of the given size over a triangle list.
+VertexCacheStats AnalyzeVertexCache(const std::vector<u32> &indices, u32 vertexCount, u32 cacheSize = 16);
+
+// Reorders triangles for post-transform cache reuse (Forsyth, "Linear-Speed Vertex Cache
+// Optimisation").
+void OptimizeVertexCache(std::vector<u32> &indices, u32 vertexCount);
+
+// Splits a cache optimized triangle list into clusters and sorts them so the ones more likely to
+// occlude the rest come first (Sander et al., "Fast Triangle Reordering for Vertex Locality and
+// Reduced Overdraw"). Threshold is how much ACMR is allowed to grow, 1.05 is a good default.
+void OptimizeOverdraw(std::vector<u32> &indices, const std::vector<Vertex> &vertices, f32 threshold);
+
+// Reorders vertices in order of first use, dropping unreferenced ones, and remaps the indices.
+void OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<u32> &indices);
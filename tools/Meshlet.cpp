@@ -0,0 +1,142 @@
+#define ARC_TOOLS
+
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	void ComputeBounds(const std::vector<Vertex> &vertices, const u32 *indices, u32 indexCount, Meshlet &meshlet)
+	{
+		// Sphere around the center of the bounding box
+		glm::vec3 boundsMin = vertices[indices[0]].pos;
+		glm::vec3 boundsMax = boundsMin;
+		for (u32 i = 1; i < indexCount; ++i)
+		{
+			boundsMin = glm::min(boundsMin, vertices[indices[i]].pos);
+			boundsMax = glm::max(boundsMax, vertices[indices[i]].pos);
+		}
+		const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+
+		f32 radius = 0.0f;
+		for (u32 i = 0; i < indexCount; ++i)
+			radius = std::max(radius, glm::length(vertices[indices[i]].pos - center));
+
+		// Cone around the average normal, wide enough to contain every triangle normal
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec3> corners;
+		normals.reserve(indexCount / 3);
+		corners.reserve(indexCount / 3);
+
+		glm::vec3 normalSum(0.0f);
+		for (u32 i = 0; i + 2 < indexCount; i += 3)
+		{
+			const glm::vec3 &a = vertices[indices[i + 0]].pos;
+			const glm::vec3 &b = vertices[indices[i + 1]].pos;
+			const glm::vec3 &c = vertices[indices[i + 2]].pos;
+
+			const glm::vec3 normal = glm::cross(b - a, c - a);
+			const f32 area = glm::length(normal);
+			// Degenerate triangles are never rasterized, they don't constrain the cone
+			if (area == 0.0f)
+				continue;
+
+			normals.push_back(normal / area);
+			corners.push_back(a);
+			normalSum += normals.back();
+		}
+
+		f32 coneCutoff = 1.0f;
+		glm::vec3 axis(0.0f, 0.0f, 1.0f);
+		glm::vec3 apex = center;
+
+		const f32 normalSumLength = glm::length(normalSum);
+		if (normalSumLength > 0.0f)
+		{
+			axis = normalSum / normalSumLength;
+
+			f32 minDot = 1.0f;
+			for (const glm::vec3 &normal : normals)
+				minDot = std::min(minDot, glm::dot(normal, axis));
+
+			// Cones this wide would hardly ever cull anything
+			if (minDot > 0.1f)
+			{
+				// Move the apex back along the axis until it is behind every triangle's plane:
+				// dot(center - t * axis - corner, normal) = 0
+				f32 maxT = 0.0f;
+				for (size_t i = 0; i < normals.size(); ++i)
+				{
+					const f32 t = glm::dot(center - corners[i], normals[i]) / glm::dot(axis, normals[i]);
+					maxT = std::max(maxT, t);
+				}
+
+				apex = center - axis * maxT;
+				coneCutoff = std::sqrt(1.0f - minDot * minDot);
+			}
+		}
+
+		for (int i = 0; i < 3; ++i)
+		{
+			meshlet.mCenter[i] = center[i];
+			meshlet.mConeApex[i] = apex[i];
+			meshlet.mConeAxis[i] = axis[i];
+		}
+		meshlet.mRadius = radius;
+		meshlet.mConeCutoff = coneCutoff;
+	}
+}
+
+std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex> &vertices, const std::vector<u32> &indices)
+{
+	std::vector<Meshlet> meshlets;
+
+	// Stamp of the last meshlet each vertex was added to, to count unique vertices
+	std::vector<u32> vertexStamps(vertices.size(), 0);
+	u32 stamp = 1;
+
+	Meshlet current = {};
+	u32 currentVertexCount = 0;
+
+	const u32 indexCount = static_cast<u32>(indices.size());
+	for (u32 i = 0; i + 2 < indexCount; i += 3)
+	{
+		u32 newVertexCount = 0;
+		for (u32 corner = 0; corner < 3; ++corner)
+		{
+			const u32 index = indices[i + corner];
+			const bool repeated = (corner > 0 && indices[i] == index) || (corner > 1 && indices[i + 1] == index);
+			if (vertexStamps[index] != stamp && !repeated)
+				++newVertexCount;
+		}
+
+		if (currentVertexCount + newVertexCount > Meshlet::MAX_VERTICES ||
+				current.mIndexCount / 3 + 1 > Meshlet::MAX_TRIANGLES)
+		{
+			meshlets.push_back(current);
+			current = {};
+			current.mIndexOffset = i;
+			currentVertexCount = 0;
+			++stamp;
+		}
+
+		for (u32 corner = 0; corner < 3; ++corner)
+		{
+			const u32 index = indices[i + corner];
+			if (vertexStamps[index] != stamp)
+			{
+				vertexStamps[index] = stamp;
+				++currentVertexCount;
+			}
+		}
+		current.mIndexCount += 3;
+	}
+	if (current.mIndexCount > 0)
+		meshlets.push_back(current);
+
+	for (Meshlet &meshlet : meshlets)
+		ComputeBounds(vertices, indices.data() + meshlet.mIndexOffset, meshlet.mIndexCount, meshlet);
+
+	return meshlets;
+}
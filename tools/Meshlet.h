@@ -0,0 +1,12 @@
+#pragma once
+
+#include "ArcGlobals.h"
+#include "engine/Resource.h"
+#include "util/Geometry.h"
+
+#include <vector>
+
+// Splits an (already cache optimized) triangle list into meshlets without reordering it: triangles
+// are added in order until the next one would go over the vertex or triangle limit. Each meshlet
+// gets a bounding sphere and a normal cone for culling.
+std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex> &vertices, const std::vector<u32> &indices);
@@ -0,0 +1,297 @@
+#define ARC_TOOLS
+
+#include "Simplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+namespace
+{
+	// A collapse is rejected if it turns any triangle around by more than this (cosine)
+	const f32 MAX_NORMAL_CHANGE = 0.25f;
+
+	// Area weighted sum of squared distances to a set of planes, divided by the total area so
+	// evaluating it gives an average squared distance
+	struct Quadric
+	{
+		f64 mA00, mA11, mA22, mA10, mA20, mA21;
+		f64 mB0, mB1, mB2;
+		f64 mC;
+		f64 mWeight;
+
+		static Quadric FromPlane(const glm::vec3 &normal, f32 distance, f32 weight)
+		{
+			Quadric q;
+			q.mA00 = weight * normal.x * normal.x;
+			q.mA11 = weight * normal.y * normal.y;
+			q.mA22 = weight * normal.z * normal.z;
+			q.mA10 = weight * normal.y * normal.x;
+			q.mA20 = weight * normal.z * normal.x;
+			q.mA21 = weight * normal.z * normal.y;
+			q.mB0 = weight * normal.x * distance;
+			q.mB1 = weight * normal.y * distance;
+			q.mB2 = weight * normal.z * distance;
+			q.mC = weight * distance * distance;
+			q.mWeight = weight;
+			return q;
+		}
+
+		Quadric &operator+=(const Quadric &other)
+		{
+			mA00 += other.mA00; mA11 += other.mA11; mA22 += other.mA22;
+			mA10 += other.mA10; mA20 += other.mA20; mA21 += other.mA21;
+			mB0 += other.mB0; mB1 += other.mB1; mB2 += other.mB2;
+			mC += other.mC;
+			mWeight += other.mWeight;
+			return *this;
+		}
+
+		f64 Evaluate(const glm::vec3 &p) const
+		{
+			const f64 x = p.x, y = p.y, z = p.z;
+			const f64 rx = mA00 * x + mA10 * y + mA20 * z + mB0;
+			const f64 ry = mA10 * x + mA11 * y + mA21 * z + mB1;
+			const f64 rz = mA20 * x + mA21 * y + mA22 * z + mB2;
+			const f64 error = rx * x + ry * y + rz * z + mB0 * x + mB1 * y + mB2 * z + mC;
+			return mWeight > 0.0 ? std::max(0.0, error / mWeight) : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		u32 mFrom;
+		u32 mTo;
+		f64 mError;
+	};
+
+	u64 EdgeKey(u32 a, u32 b)
+	{
+		return (static_cast<u64>(a) << 32) | b;
+	}
+
+	// Vertices that can't be moved without changing the silhouette of a border or tearing a seam
+	std::vector<bool> FindLockedVertices(const std::vector<Vertex> &vertices, const std::vector<u32> &indices)
+	{
+		const u32 vertexCount = static_cast<u32>(vertices.size());
+
+		// Vertices sharing a position are wedges of the same point with different attributes
+		std::vector<u32> order(vertexCount);
+		for (u32 i = 0; i < vertexCount; ++i)
+			order[i] = i;
+		auto lessPosition = [&](u32 a, u32 b)
+		{
+			const glm::vec3 &pa = vertices[a].pos;
+			const glm::vec3 &pb = vertices[b].pos;
+			if (pa.x != pb.x) return pa.x < pb.x;
+			if (pa.y != pb.y) return pa.y < pb.y;
+			return pa.z < pb.z;
+		};
+		std::sort(order.begin(), order.end(), lessPosition);
+
+		std::vector<u32> positionId(vertexCount);
+		std::vector<bool> locked(vertexCount, false);
+		for (u32 begin = 0, end = 0; begin < vertexCount; begin = end)
+		{
+			end = begin + 1;
+			while (end < vertexCount && vertices[order[end]].pos == vertices[order[begin]].pos)
+				++end;
+			for (u32 i = begin; i < end; ++i)
+			{
+				positionId[order[i]] = order[begin];
+				locked[order[i]] = end - begin > 1;
+			}
+		}
+
+		// An edge without its opposite half edge is on a border. Edges used more than once in the
+		// same direction are non-manifold, lock those too.
+		std::unordered_multiset<u64> halfEdges;
+		halfEdges.reserve(indices.size());
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (int e = 0; e < 3; ++e)
+			{
+				const u32 a = positionId[indices[i + e]];
+				const u32 b = positionId[indices[i + (e + 1) % 3]];
+				halfEdges.insert(EdgeKey(a, b));
+			}
+		}
+
+		std::vector<bool> lockedPosition(vertexCount, false);
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (int e = 0; e < 3; ++e)
+			{
+				const u32 a = positionId[indices[i + e]];
+				const u32 b = positionId[indices[i + (e + 1) % 3]];
+				if (halfEdges.count(EdgeKey(b, a)) != 1 || halfEdges.count(EdgeKey(a, b)) != 1)
+				{
+					lockedPosition[a] = true;
+					lockedPosition[b] = true;
+				}
+			}
+		}
+
+		for (u32 i = 0; i < vertexCount; ++i)
+			locked[i] = locked[i] || lockedPosition[positionId[i]];
+		return locked;
+	}
+
+	// Whether moving `from` onto `to` keeps every other triangle around `from` facing the same way
+	bool KeepsOrientation(const std::vector<Vertex> &vertices, const std::vector<u32> &indices,
+			const u32 *triangles, u32 triangleCount, u32 from, u32 to)
+	{
+		for (u32 t = 0; t < triangleCount; ++t)
+		{
+			const u32 *triangle = &indices[triangles[t] * 3];
+			if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+				continue;
+
+			glm::vec3 before[3];
+			glm::vec3 after[3];
+			for (int i = 0; i < 3; ++i)
+			{
+				before[i] = vertices[triangle[i]].pos;
+				after[i] = triangle[i] == from ? vertices[to].pos : before[i];
+			}
+
+			const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+			const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+			const f32 lengths = glm::length(normalBefore) * glm::length(normalAfter);
+			if (lengths == 0.0f || glm::dot(normalBefore, normalAfter) < MAX_NORMAL_CHANGE * lengths)
+				return false;
+		}
+		return true;
+	}
+}
+
+f32 SimplifyMesh(const std::vector<Vertex> &vertices, const std::vector<u32> &indices, u32 targetIndexCount,
+		std::vector<u32> &result)
+{
+	const u32 vertexCount = static_cast<u32>(vertices.size());
+	result = indices;
+
+	const std::vector<bool> locked = FindLockedVertices(vertices, indices);
+
+	std::vector<Quadric> quadrics(vertexCount, Quadric {});
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const glm::vec3 &a = vertices[indices[i + 0]].pos;
+		const glm::vec3 &b = vertices[indices[i + 1]].pos;
+		const glm::vec3 &c = vertices[indices[i + 2]].pos;
+
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		const f32 area = glm::length(normal);
+		if (area == 0.0f)
+			continue;
+		normal /= area;
+
+		const Quadric q = Quadric::FromPlane(normal, -glm::dot(normal, a), area);
+		for (int e = 0; e < 3; ++e)
+			quadrics[indices[i + e]] += q;
+	}
+
+	f64 maxError = 0.0;
+	std::vector<Collapse> collapses;
+	std::vector<u32> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<u32> triangleOffsets(vertexCount + 1);
+	std::vector<u32> vertexTriangles;
+
+	while (result.size() > targetIndexCount)
+	{
+		const u32 triangleCount = static_cast<u32>(result.size() / 3);
+
+		// Triangles around each vertex, for the orientation checks
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (u32 index : result)
+			++triangleOffsets[index + 1];
+		for (u32 i = 0; i < vertexCount; ++i)
+			triangleOffsets[i + 1] += triangleOffsets[i];
+		vertexTriangles.resize(result.size());
+		{
+			std::vector<u32> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (u32 t = 0; t < triangleCount; ++t)
+				for (int e = 0; e < 3; ++e)
+					vertexTriangles[fill[result[t * 3 + e]]++] = t;
+		}
+
+		// Cheapest direction of every edge, each edge shows up once per adjacent triangle
+		collapses.clear();
+		for (u32 t = 0; t < triangleCount; ++t)
+		{
+			for (int e = 0; e < 3; ++e)
+			{
+				const u32 a = result[t * 3 + e];
+				const u32 b = result[t * 3 + (e + 1) % 3];
+				// Interior edges are seen once from each side, borders only have locked vertices
+				if (a > b)
+					continue;
+
+				const f64 errorAB = locked[a] ? HUGE_VAL : quadrics[a].Evaluate(vertices[b].pos);
+				const f64 errorBA = locked[b] ? HUGE_VAL : quadrics[b].Evaluate(vertices[a].pos);
+				if (errorAB == HUGE_VAL && errorBA == HUGE_VAL)
+					continue;
+
+				if (errorAB <= errorBA)
+					collapses.push_back(Collapse { a, b, errorAB });
+				else
+					collapses.push_back(Collapse { b, a, errorBA });
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b)
+		{
+			return a.mError < b.mError;
+		});
+
+		// Every collapse removes two triangles on a closed surface. Vertices around a collapse are
+		// left alone for the rest of the pass so the orientation checks stay valid.
+		const u32 wantedCollapses = static_cast<u32>((result.size() - targetIndexCount) / 6 + 1);
+		for (u32 i = 0; i < vertexCount; ++i)
+			remap[i] = i;
+		std::fill(touched.begin(), touched.end(), false);
+
+		u32 collapseCount = 0;
+		for (const Collapse &collapse : collapses)
+		{
+			if (collapseCount >= wantedCollapses)
+				break;
+			if (touched[collapse.mFrom] || touched[collapse.mTo])
+				continue;
+
+			const u32 *triangles = &vertexTriangles[triangleOffsets[collapse.mFrom]];
+			const u32 count = triangleOffsets[collapse.mFrom + 1] - triangleOffsets[collapse.mFrom];
+			if (!KeepsOrientation(vertices, result, triangles, count, collapse.mFrom, collapse.mTo))
+				continue;
+
+			remap[collapse.mFrom] = collapse.mTo;
+			quadrics[collapse.mTo] += quadrics[collapse.mFrom];
+			maxError = std::max(maxError, collapse.mError);
+			++collapseCount;
+
+			for (u32 t = 0; t < count; ++t)
+				for (int e = 0; e < 3; ++e)
+					touched[result[triangles[t] * 3 + e]] = true;
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		// Drop the triangles that collapsed into lines
+		size_t writeIndex = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			const u32 a = remap[result[i + 0]];
+			const u32 b = remap[result[i + 1]];
+			const u32 c = remap[result[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+			result[writeIndex++] = a;
+			result[writeIndex++] = b;
+			result[writeIndex++] = c;
+		}
+		result.resize(writeIndex);
+	}
+
+	return static_cast<f32>(std::sqrt(maxError));
+}
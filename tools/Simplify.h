@@ -0,0 +1,14 @@
+#pragma once
+
+#include "ArcGlobals.h"
+#include "util/Geometry.h"
+
+#include <vector>
+
+// Quadric error edge collapse (Garland & Heckbert, "Surface Simplification Using Quadric Error
+// Metrics") that keeps the vertex buffer and only produces a new index list, so every LOD can
+// share the same vertices. Vertices on open borders and texture seams never move. Stops once
+// there are no more than targetIndexCount indices or nothing else can be collapsed. Returns the
+// error of the result as an object space distance.
+f32 SimplifyMesh(const std::vector<Vertex> &vertices, const std::vector<u32> &indices, u32 targetIndexCount,
+		std::vector<u32> &result);
@@ -0,0 +1,166 @@
+#define ARC_TOOLS
+
+#include "VertexEncode.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// Round to nearest even, flushing values too small for a half to zero
+	u16 FloatToHalf(f32 value)
+	{
+		u32 bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		const u32 sign = (bits >> 16) & 0x8000;
+		const s32 exponent = static_cast<s32>((bits >> 23) & 0xFF) - 127 + 15;
+		u32 mantissa = bits & 0x7FFFFF;
+
+		if (exponent <= 0)
+			return static_cast<u16>(sign);
+		if (exponent >= 31)
+			return static_cast<u16>(sign | 0x7C00);
+
+		u32 half = (static_cast<u32>(exponent) << 10) | (mantissa >> 13);
+		const u32 rest = mantissa & 0x1FFF;
+		if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+			++half;
+		return static_cast<u16>(sign | half);
+	}
+
+	u16 FloatToUnorm16(f32 value)
+	{
+		return static_cast<u16>(std::round(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+	}
+
+	u8 FloatToUnorm8(f32 value)
+	{
+		return static_cast<u8>(std::round(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+	}
+
+	bool IsUnorm(f32 value)
+	{
+		return value >= 0.0f && value <= 1.0f;
+	}
+
+	template<typename T>
+	void Write(u8 *&writePtr, const T &value)
+	{
+		memcpy(writePtr, &value, sizeof(T));
+		writePtr += sizeof(T);
+	}
+}
+
+void EncodeVertices(const std::vector<Vertex> &vertices, PositionFormat positionFormat,
+		GraphicResourceHeader &header, std::vector<u8> &positionData, std::vector<u8> &attributeData)
+{
+	glm::vec3 boundsMin(0.0f);
+	glm::vec3 boundsMax(0.0f);
+	if (!vertices.empty())
+		boundsMin = boundsMax = vertices[0].pos;
+
+	bool constantColor = true;
+	bool unormColor = true;
+	bool unormTexCoord = true;
+	for (const Vertex &vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.pos);
+		boundsMax = glm::max(boundsMax, vertex.pos);
+
+		constantColor = constantColor && vertex.color == vertices[0].color;
+		for (int i = 0; i < 3; ++i)
+			unormColor = unormColor && IsUnorm(vertex.color[i]);
+		for (int i = 0; i < 2; ++i)
+			unormTexCoord = unormTexCoord && IsUnorm(vertex.texCoord[i]);
+	}
+
+	VertexLayout &layout = header.mVertexLayout;
+	layout.mPositionFormat = static_cast<u8>(positionFormat);
+	if (constantColor)
+		layout.mColorFormat = COLORFORMAT_CONSTANT;
+	else
+		layout.mColorFormat = unormColor ? COLORFORMAT_UNORM8X4 : COLORFORMAT_FLOAT3;
+	layout.mTexCoordFormat = unormTexCoord ? TEXCOORDFORMAT_UNORM16X2 : TEXCOORDFORMAT_FLOAT2;
+	layout.mPadding = 0;
+
+	glm::vec3 offset(0.0f);
+	glm::vec3 scale(1.0f);
+	if (positionFormat == POSITIONFORMAT_UNORM16X4)
+	{
+		offset = boundsMin;
+		scale = boundsMax - boundsMin;
+		// Flat meshes would divide by zero, any scale works for them
+		for (int i = 0; i < 3; ++i)
+			if (scale[i] <= 0.0f)
+				scale[i] = 1.0f;
+	}
+	else if (positionFormat == POSITIONFORMAT_HALF4)
+	{
+		// Centering keeps the values small, where halves are most precise
+		offset = (boundsMin + boundsMax) * 0.5f;
+	}
+
+	for (int i = 0; i < 3; ++i)
+	{
+		header.mPositionOffset[i] = offset[i];
+		header.mPositionScale[i] = scale[i];
+	}
+
+	const glm::vec3 color = vertices.empty() ? glm::vec3(1.0f) : vertices[0].color;
+	for (int i = 0; i < 3; ++i)
+		header.mConstantColor[i] = color[i];
+	header.mConstantColor[3] = 1.0f;
+
+	positionData.resize(static_cast<size_t>(layout.GetPositionStride()) * vertices.size());
+	attributeData.resize(static_cast<size_t>(layout.GetAttributeStride()) * vertices.size());
+
+	u8 *positionPtr = positionData.data();
+	u8 *attributePtr = attributeData.data();
+	for (const Vertex &vertex : vertices)
+	{
+		const glm::vec3 pos = (vertex.pos - offset) / scale;
+		switch (positionFormat)
+		{
+			case POSITIONFORMAT_FLOAT3:
+				for (int i = 0; i < 3; ++i)
+					Write(positionPtr, pos[i]);
+				break;
+			case POSITIONFORMAT_HALF4:
+				for (int i = 0; i < 3; ++i)
+					Write(positionPtr, FloatToHalf(pos[i]));
+				Write(positionPtr, static_cast<u16>(0));
+				break;
+			case POSITIONFORMAT_UNORM16X4:
+				for (int i = 0; i < 3; ++i)
+					Write(positionPtr, FloatToUnorm16(pos[i]));
+				Write(positionPtr, static_cast<u16>(0));
+				break;
+		}
+
+		switch (layout.mColorFormat)
+		{
+			case COLORFORMAT_FLOAT3:
+				for (int i = 0; i < 3; ++i)
+					Write(attributePtr, vertex.color[i]);
+				break;
+			case COLORFORMAT_UNORM8X4:
+				for (int i = 0; i < 3; ++i)
+					Write(attributePtr, FloatToUnorm8(vertex.color[i]));
+				Write(attributePtr, static_cast<u8>(255));
+				break;
+		}
+
+		if (layout.mTexCoordFormat == TEXCOORDFORMAT_UNORM16X2)
+		{
+			for (int i = 0; i < 2; ++i)
+				Write(attributePtr, FloatToUnorm16(vertex.texCoord[i]));
+		}
+		else
+		{
+			for (int i = 0; i < 2; ++i)
+				Write(attributePtr, vertex.texCoord[i]);
+		}
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "ArcGlobals.h"
+#include "engine/Resource.h"
+#include "util/Geometry.h"
+
+#include <vector>
+
+// Picks the smallest layout that represents the vertices (falling back to floats for attributes
+// that don't fit the quantized range) and packs them into a position and an attribute stream. Fills
+// in the layout, position transform and constant attribute values of the header.
+void EncodeVertices(const std::vector<Vertex> &vertices, PositionFormat positionFormat,
+		GraphicResourceHeader &header, std::vector<u8> &positionData, std::vector<u8> &attributeData);
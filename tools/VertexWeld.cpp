@@ -0,0 +1,246 @@
+#define ARC_TOOLS
+
+#include "VertexWeld.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+// Vertices are hashed and compared as raw bytes, so there can't be any padding in them
+static_assert(sizeof(Vertex) == 8 * sizeof(f32), "Vertex has padding");
+
+namespace
+{
+	const u32 EMPTY_SLOT = UINT32_MAX;
+
+	f32 Snap(f32 value, f32 epsilon)
+	{
+		if (epsilon > 0.0f)
+			value = std::round(value / epsilon) * epsilon;
+		// Adding zero turns -0 into +0, otherwise they'd compare equal but hash differently
+		return value + 0.0f;
+	}
+
+	Vertex MakeWeldKey(const Vertex &vertex, const WeldSettings &settings)
+	{
+		Vertex key;
+		for (int i = 0; i < 3; ++i)
+		{
+			key.pos[i] = Snap(vertex.pos[i], settings.mPositionEpsilon);
+			key.color[i] = Snap(vertex.color[i], 0.0f);
+		}
+		for (int i = 0; i < 2; ++i)
+			key.texCoord[i] = Snap(vertex.texCoord[i], settings.mTexCoordEpsilon);
+		return key;
+	}
+
+	// MurmurHash3 finalizer
+	u64 Mix64(u64 k)
+	{
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdull;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53ull;
+		k ^= k >> 33;
+		return k;
+	}
+
+	u64 HashBytes(const void *data, size_t size)
+	{
+		const u8 *bytes = static_cast<const u8 *>(data);
+		u64 hash = 0x9e3779b97f4a7c15ull ^ size;
+		for (size_t i = 0; i + 8 <= size; i += 8)
+		{
+			u64 word;
+			memcpy(&word, bytes + i, sizeof(word));
+			hash ^= Mix64(word);
+			hash = ((hash << 27) | (hash >> 37)) * 0x9e3779b97f4a7c15ull + 0x52dce729ull;
+		}
+		return Mix64(hash);
+	}
+
+	// Open addressing, linear probing. Keys of the vertices found so far are kept packed in insertion
+	// order so that probing doesn't jump all over the (much larger) per-corner key array.
+	class WeldTable
+	{
+		struct Slot
+		{
+			u32 mHash;
+			u32 mEntry;
+		};
+
+		std::vector<Slot> mSlots;
+		std::vector<Vertex> mKeys;
+		std::vector<u32> mCorners;
+		size_t mMask;
+
+		void Grow()
+		{
+			std::vector<Slot> oldSlots(mSlots.size() * 2, Slot { 0, EMPTY_SLOT });
+			oldSlots.swap(mSlots);
+			mMask = mSlots.size() - 1;
+			for (const Slot &slot : oldSlots)
+			{
+				if (slot.mEntry == EMPTY_SLOT)
+					continue;
+				size_t index = slot.mHash & mMask;
+				while (mSlots[index].mEntry != EMPTY_SLOT)
+					index = (index + 1) & mMask;
+				mSlots[index] = slot;
+			}
+		}
+
+	public:
+		explicit WeldTable(size_t expectedCount)
+		{
+			size_t capacity = 16;
+			while (capacity < expectedCount * 2)
+				capacity *= 2;
+			mSlots.assign(capacity, Slot { 0, EMPTY_SLOT });
+			mMask = capacity - 1;
+		}
+
+		// Returns the first corner inserted with the same key, or `corner` itself if it's new.
+		u32 FindOrInsert(u32 corner, u64 hash, const Vertex &key)
+		{
+			if ((mKeys.size() + 1) * 2 > mSlots.size())
+				Grow();
+
+			const u32 shortHash = static_cast<u32>(hash);
+			size_t index = shortHash & mMask;
+			for (;;)
+			{
+				Slot &slot = mSlots[index];
+				if (slot.mEntry == EMPTY_SLOT)
+				{
+					slot.mHash = shortHash;
+					slot.mEntry = static_cast<u32>(mKeys.size());
+					mKeys.push_back(key);
+					mCorners.push_back(corner);
+					return corner;
+				}
+				if (slot.mHash == shortHash && memcmp(&mKeys[slot.mEntry], &key, sizeof(Vertex)) == 0)
+					return mCorners[slot.mEntry];
+				index = (index + 1) & mMask;
+			}
+		}
+	};
+
+	// Runs job(taskIndex) for every task, one thread per task, the last one on the calling thread.
+	template<typename Job>
+	void RunTasks(u32 taskCount, const Job &job)
+	{
+		std::vector<std::thread> threads;
+		threads.reserve(taskCount);
+		for (u32 task = 0; task + 1 < taskCount; ++task)
+			threads.emplace_back(job, task);
+		job(taskCount - 1);
+		for (std::thread &thread : threads)
+			thread.join();
+	}
+}
+
+WeldStats WeldVertices(const std::vector<Vertex> &corners, const WeldSettings &settings,
+		std::vector<Vertex> &vertices, std::vector<u32> &indices)
+{
+	const auto startTime = std::chrono::high_resolution_clock::now();
+
+	const u32 cornerCount = static_cast<u32>(corners.size());
+
+	u32 threadCount = settings.mThreadCount;
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	if (cornerCount < settings.mParallelThreshold)
+		threadCount = 1;
+
+	// Shards are picked from the top bits of the hash, the table slot from the bottom bits
+	u32 shardBits = 0;
+	while ((2u << shardBits) <= threadCount)
+		++shardBits;
+	const u32 shardCount = 1u << shardBits;
+
+	const auto getShard = [&](u64 hash) { return shardBits ? static_cast<u32>(hash >> (64 - shardBits)) : 0; };
+
+	// Each task also counts how many of its corners land in every shard
+	std::vector<Vertex> keys(cornerCount);
+	std::vector<u64> hashes(cornerCount);
+	std::vector<u32> shardOffsets(threadCount * shardCount, 0);
+	RunTasks(threadCount, [&](u32 task)
+	{
+		const u32 begin = static_cast<u32>(static_cast<u64>(cornerCount) * task / threadCount);
+		const u32 end = static_cast<u32>(static_cast<u64>(cornerCount) * (task + 1) / threadCount);
+		u32 *counts = &shardOffsets[task * shardCount];
+		for (u32 i = begin; i < end; ++i)
+		{
+			keys[i] = MakeWeldKey(corners[i], settings);
+			hashes[i] = HashBytes(&keys[i], sizeof(Vertex));
+			++counts[getShard(hashes[i])];
+		}
+	});
+
+	// Counts to offsets, shard by shard and task by task within a shard, so every shard's corners end
+	// up contiguous and in order
+	std::vector<u32> shardBegin(shardCount + 1);
+	u32 offset = 0;
+	for (u32 shard = 0; shard < shardCount; ++shard)
+	{
+		shardBegin[shard] = offset;
+		for (u32 task = 0; task < threadCount; ++task)
+		{
+			const u32 count = shardOffsets[task * shardCount + shard];
+			shardOffsets[task * shardCount + shard] = offset;
+			offset += count;
+		}
+	}
+	shardBegin[shardCount] = offset;
+
+	std::vector<u32> shardCorners(cornerCount);
+	RunTasks(threadCount, [&](u32 task)
+	{
+		const u32 begin = static_cast<u32>(static_cast<u64>(cornerCount) * task / threadCount);
+		const u32 end = static_cast<u32>(static_cast<u64>(cornerCount) * (task + 1) / threadCount);
+		u32 *offsets = &shardOffsets[task * shardCount];
+		for (u32 i = begin; i < end; ++i)
+			shardCorners[offsets[getShard(hashes[i])]++] = i;
+	});
+
+	// Every key lands in exactly one shard, so shards don't need any locking. Each shard walks its
+	// corners in order, which keeps the first occurrence as the representative of each vertex.
+	std::vector<u32> firstCorner(cornerCount);
+	RunTasks(shardCount, [&](u32 shard)
+	{
+		WeldTable table(shardBegin[shard + 1] - shardBegin[shard]);
+		for (u32 j = shardBegin[shard]; j < shardBegin[shard + 1]; ++j)
+		{
+			const u32 i = shardCorners[j];
+			firstCorner[i] = table.FindOrInsert(i, hashes[i], keys[i]);
+		}
+	});
+
+	// firstCorner[i] <= i, so the index of the representative is always written before it's read
+	vertices.clear();
+	indices.resize(cornerCount);
+	for (u32 i = 0; i < cornerCount; ++i)
+	{
+		if (firstCorner[i] == i)
+		{
+			indices[i] = static_cast<u32>(vertices.size());
+			vertices.push_back(corners[i]);
+		}
+		else
+		{
+			indices[i] = indices[firstCorner[i]];
+		}
+	}
+
+	const auto endTime = std::chrono::high_resolution_clock::now();
+
+	WeldStats stats;
+	stats.mCornerCount = cornerCount;
+	stats.mVertexCount = static_cast<u32>(vertices.size());
+	stats.mThreadCount = threadCount;
+	stats.mMilliseconds = std::chrono::duration<f64, std::milli>(endTime - startTime).count();
+	return stats;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ArcGlobals.h"
+#include "util/Geometry.h"
+
+#include <vector>
+
+struct WeldSettings
+{
+	// Grid size used to snap attributes before comparing them. Zero means exact (bitwise) weld.
+	f32 mPositionEpsilon = 0.0f;
+	f32 mTexCoordEpsilon = 0.0f;
+	// Zero means one thread per hardware thread.
+	u32 mThreadCount = 0;
+	// Meshes with fewer corners than this are welded on the calling thread.
+	u32 mParallelThreshold = 1 << 16;
+};
+
+struct WeldStats
+{
+	u32 mCornerCount;
+	u32 mVertexCount;
+	u32 mThreadCount;
+	f64 mMilliseconds;
+};
+
+// Takes one vertex per triangle corner and produces a deduplicated vertex list plus one index per
+// corner. Output order is the order of first occurrence, regardless of the thread count.
+WeldStats WeldVertices(const std::vector<Vertex> &corners, const WeldSettings &settings,
+		std::vector<Vertex> &vertices, std::vector<u32> &indices);
@@ -1,29 +1,50 @@
 #define ARC_TOOLS
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <unordered_map>
 #include <filesystem>
 
 #include "ArcGlobals.h"
 #include "engine/Resource.h"
 #include "util/Geometry.h"
+#include "MeshOptimizer.h"
+#include "Meshlet.h"
+#include "Simplify.h"
+#include "VertexEncode.h"
+#include "VertexWeld.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
-void LoadModel(const std::string &filename, std::vector<Vertex> &vertices, std::vector<u32> &indices)
+struct BakeSettings
+{
+	WeldSettings mWeld;
+	// Zero disables overdraw optimization
+	f32 mOverdrawThreshold = 0.0f;
+	PositionFormat mPositionFormat = POSITIONFORMAT_UNORM16X4;
+	u32 mLodCount = 4;
+};
+
+void LoadModel(const std::string &filename, const WeldSettings &weldSettings, std::vector<Vertex> &vertices,
+		std::vector<u32> &indices)
 {
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
 	std::string warn, err;
 
-	std::unordered_map<Vertex, u32> uniqueVertices = {};
-
 	ARC_ASSERT(tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str()));
 
+	// One vertex per triangle corner, welded afterwards
+	size_t cornerCount = 0;
+	for (const auto &shape : shapes)
+		cornerCount += shape.mesh.indices.size();
+
+	std::vector<Vertex> corners;
+	corners.reserve(cornerCount);
+
 	for (const auto &shape : shapes)
 	{
 		for (const auto &index : shape.mesh.indices)
@@ -45,60 +66,255 @@ void LoadModel(const std::string &filename, std::vector<Vertex> &vertices, std::
 
 			vertex.color = { 1.0f, 1.0f, 1.0f };
 
-			if (uniqueVertices.count(vertex) == 0)
-			{
-				uniqueVertices[vertex] = static_cast<u32>(vertices.size());
-				vertices.push_back(vertex);
-			}
-
-			indices.push_back(uniqueVertices[vertex]);
+			corners.push_back(vertex);
 		}
 	}
+
+	const WeldStats weldStats = WeldVertices(corners, weldSettings, vertices, indices);
+	std::cout << "  Weld: " << weldStats.mCornerCount << " corners -> " << weldStats.mVertexCount <<
+		" vertices (" << static_cast<f64>(weldStats.mCornerCount) / std::max(1u, weldStats.mVertexCount) <<
+		"x) in " << weldStats.mMilliseconds << " ms on " << weldStats.mThreadCount << " thread(s)" << std::endl;
+}
+
+// Each LOD aims for half the triangles of the previous one, the chain ends early when the
+// simplifier gets stuck (on seams and borders). Every LOD is simplified from LOD 0, so its error
+// is measured against the full mesh rather than the previous LOD.
+void SimplifyModel(const BakeSettings &settings, const std::vector<Vertex> &vertices, std::vector<u32> &indices,
+		std::vector<std::vector<u32>> &lodIndices, std::vector<MeshLod> &lods)
+{
+	lodIndices.clear();
+	lods.clear();
+
+	lodIndices.push_back(std::move(indices));
+	lods.push_back(MeshLod {});
+
+	while (lods.size() < settings.mLodCount)
+	{
+		const std::vector<u32> &previous = lodIndices.back();
+		const u32 targetIndexCount = static_cast<u32>(previous.size() / 6 * 3);
+
+		std::vector<u32> simplified;
+		const f32 error = SimplifyMesh(vertices, lodIndices[0], targetIndexCount, simplified);
+		if (simplified.empty() || simplified.size() > previous.size() * 9 / 10)
+			break;
+
+		MeshLod lod = {};
+		lod.mError = std::max(error, lods.back().mError);
+		lodIndices.push_back(std::move(simplified));
+		lods.push_back(lod);
+	}
+
+	std::cout << "  LODs:";
+	for (size_t i = 0; i < lods.size(); ++i)
+		std::cout << " " << lodIndices[i].size() / 3 << " (" << lods[i].mError << ")";
+	std::cout << std::endl;
+}
+
+void OptimizeModel(const BakeSettings &settings, std::vector<Vertex> &vertices,
+		std::vector<std::vector<u32>> &lodIndices, std::vector<u32> &indices, std::vector<MeshLod> &lods)
+{
+	const VertexCacheStats before = AnalyzeVertexCache(lodIndices[0], static_cast<u32>(vertices.size()));
+
+	indices.clear();
+	for (size_t i = 0; i < lodIndices.size(); ++i)
+	{
+		OptimizeVertexCache(lodIndices[i], static_cast<u32>(vertices.size()));
+		if (settings.mOverdrawThreshold > 0.0f)
+			OptimizeOverdraw(lodIndices[i], vertices, settings.mOverdrawThreshold);
+
+		lods[i].mIndexOffset = static_cast<u32>(indices.size());
+		lods[i].mIndexCount = static_cast<u32>(lodIndices[i].size());
+		indices.insert(indices.end(), lodIndices[i].begin(), lodIndices[i].end());
+	}
+
+	// All LODs share the vertices, LOD 0 comes first so it gets the best fetch locality
+	OptimizeVertexFetch(vertices, indices);
+
+	const std::vector<u32> lod0(indices.begin(), indices.begin() + lods[0].mIndexCount);
+	const VertexCacheStats after = AnalyzeVertexCache(lod0, static_cast<u32>(vertices.size()));
+	std::cout << "  Vertex cache: ACMR " << before.mAcmr << " -> " << after.mAcmr << ", ATVR " <<
+		before.mAtvr << " -> " << after.mAtvr << std::endl;
 }
 
-void ExportModel(const std::string &filename, std::vector<Vertex> &vertices, std::vector<u32> &indices)
+void ClusterModel(const std::vector<Vertex> &vertices, const std::vector<u32> &indices, std::vector<MeshLod> &lods,
+		std::vector<Meshlet> &meshlets)
+{
+	meshlets.clear();
+	for (MeshLod &lod : lods)
+	{
+		const std::vector<u32> lodIndices(indices.begin() + lod.mIndexOffset,
+				indices.begin() + lod.mIndexOffset + lod.mIndexCount);
+		std::vector<Meshlet> lodMeshlets = BuildMeshlets(vertices, lodIndices);
+		for (Meshlet &meshlet : lodMeshlets)
+			meshlet.mIndexOffset += lod.mIndexOffset;
+
+		lod.mMeshletOffset = static_cast<u32>(meshlets.size());
+		lod.mMeshletCount = static_cast<u32>(lodMeshlets.size());
+		meshlets.insert(meshlets.end(), lodMeshlets.begin(), lodMeshlets.end());
+	}
+
+	u32 coneCount = 0;
+	for (const Meshlet &meshlet : meshlets)
+		coneCount += meshlet.mConeCutoff < 1.0f;
+	std::cout << "  Meshlets: " << meshlets.size() << ", " << static_cast<f64>(lods[0].mIndexCount / 3) /
+		std::max<u32>(1, lods[0].mMeshletCount) << " triangles on average in LOD 0, " << coneCount <<
+		" with a usable normal cone" << std::endl;
+}
+
+// Box around every vertex, and a sphere around the center of the box
+void ComputeBounds(const std::vector<Vertex> &vertices, GraphicResourceHeader &header)
+{
+	glm::vec3 boundsMin(0.0f);
+	glm::vec3 boundsMax(0.0f);
+	if (!vertices.empty())
+		boundsMin = boundsMax = vertices[0].pos;
+	for (const Vertex &vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.pos);
+		boundsMax = glm::max(boundsMax, vertex.pos);
+	}
+
+	const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	f32 radius = 0.0f;
+	for (const Vertex &vertex : vertices)
+		radius = std::max(radius, glm::length(vertex.pos - center));
+
+	for (int i = 0; i < 3; ++i)
+	{
+		header.mBoundsMin[i] = boundsMin[i];
+		header.mBoundsMax[i] = boundsMax[i];
+		header.mBoundsCenter[i] = center[i];
+	}
+	header.mBoundsRadius = radius;
+}
+
+void ExportModel(const std::string &filename, const BakeSettings &settings, std::vector<Vertex> &vertices,
+		std::vector<u32> &indices, const std::vector<Meshlet> &meshlets, const std::vector<MeshLod> &lods)
 {
 	std::ofstream outputFile;
 	outputFile.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
 
 	ResourceHeader header;
+	GraphicResourceHeader graphicHeader;
+
+	graphicHeader.mVertexCount = static_cast<u32>(vertices.size());
+	graphicHeader.mIndexCount = static_cast<u32>(indices.size());
+	graphicHeader.mMeshletCount = static_cast<u32>(meshlets.size());
+	graphicHeader.mLodCount = static_cast<u32>(lods.size());
+	// Primitive restart is never enabled, so 0xFFFF is a valid 16-bit index
+	graphicHeader.mIndexSize = vertices.size() <= 65536 ? sizeof(u16) : sizeof(u32);
 
-	u32 vertexCount = static_cast<u32>(vertices.size());
-	u32 indexCount = static_cast<u32>(indices.size());
-	u64 vertexDataSize = sizeof(Vertex) * vertexCount;
-	u64 indexDataSize = sizeof(u32) * indexCount;
+	ComputeBounds(vertices, graphicHeader);
 
-	u64 fileSize = 2 * sizeof(u32) + vertexDataSize + indexDataSize;
+	std::vector<u8> positionData;
+	std::vector<u8> attributeData;
+	EncodeVertices(vertices, settings.mPositionFormat, graphicHeader, positionData, attributeData);
+
+	u64 vertexDataSize = positionData.size() + attributeData.size();
+	u64 indexDataSize = static_cast<u64>(graphicHeader.mIndexSize) * graphicHeader.mIndexCount;
+
+	u64 meshletDataSize = sizeof(Meshlet) * meshlets.size();
+	u64 lodDataSize = sizeof(MeshLod) * lods.size();
+
+	u64 fileSize = sizeof(GraphicResourceHeader) + vertexDataSize + indexDataSize + meshletDataSize + lodDataSize;
 
 	// Header
 	memcpy(header.mSignature, "ARCR", 4);
 	header.mType = RESOURCETYPE_GRAPHIC;
 	header.mSize = fileSize;
 	outputFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
-	
-	outputFile.write(reinterpret_cast<const char *>(&vertexCount), sizeof(u32));
-	outputFile.write(reinterpret_cast<const char *>(&indexCount), sizeof(u32));
 
-	outputFile.write(reinterpret_cast<const char *>(vertices.data()), vertexDataSize);
-	outputFile.write(reinterpret_cast<const char *>(indices.data()), indexDataSize);
+	outputFile.write(reinterpret_cast<const char *>(&graphicHeader), sizeof(graphicHeader));
+
+	outputFile.write(reinterpret_cast<const char *>(positionData.data()), positionData.size());
+	outputFile.write(reinterpret_cast<const char *>(attributeData.data()), attributeData.size());
+
+	if (graphicHeader.mIndexSize == sizeof(u16))
+	{
+		// The largest index is mVertexCount - 1
+		ARC_ASSERT(graphicHeader.mVertexCount <= 0x10000);
+		std::vector<u16> shortIndices(indices.size());
+		for (size_t i = 0; i < indices.size(); ++i)
+			shortIndices[i] = static_cast<u16>(indices[i]);
+		outputFile.write(reinterpret_cast<const char *>(shortIndices.data()), indexDataSize);
+	}
+	else
+	{
+		outputFile.write(reinterpret_cast<const char *>(indices.data()), indexDataSize);
+	}
+
+	outputFile.write(reinterpret_cast<const char *>(meshlets.data()), meshletDataSize);
+	outputFile.write(reinterpret_cast<const char *>(lods.data()), lodDataSize);
 
 	outputFile.close();
+
+	std::cout << "  Export: " << graphicHeader.mVertexCount << " vertices, " << graphicHeader.mIndexCount <<
+		" indices, " << graphicHeader.mIndexSize * 8 << "-bit, " << graphicHeader.mVertexLayout.GetPositionStride() <<
+		" + " << graphicHeader.mVertexLayout.GetAttributeStride() << " bytes per vertex (was " << sizeof(Vertex) << ")" <<
+		std::endl;
 }
 
 int main(int argc, char **argv)
 {
-	ARC_UNUSED(argc);
-	ARC_UNUSED(argv);
+	BakeSettings settings;
+
+	// -e <epsilon>: quantized weld, snaps positions and texture coordinates to a grid of this size
+	// -j <threads>: welding threads, 0 picks one per hardware thread
+	// -o <threshold>: sort triangle clusters to reduce overdraw, letting ACMR grow by this factor
+	// -p <float|half|unorm>: position format, unorm (quantized to the mesh bounds) by default
+	// -l <count>: maximum number of LODs, including the full mesh
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const std::string arg = argv[i];
+		if (arg == "-e")
+		{
+			settings.mWeld.mPositionEpsilon = std::stof(argv[i + 1]);
+			settings.mWeld.mTexCoordEpsilon = settings.mWeld.mPositionEpsilon;
+		}
+		else if (arg == "-j")
+		{
+			settings.mWeld.mThreadCount = static_cast<u32>(std::stoul(argv[i + 1]));
+		}
+		else if (arg == "-o")
+		{
+			settings.mOverdrawThreshold = std::stof(argv[i + 1]);
+		}
+		else if (arg == "-l")
+		{
+			settings.mLodCount = std::max(1u, static_cast<u32>(std::stoul(argv[i + 1])));
+		}
+		else if (arg == "-p")
+		{
+			const std::string format = argv[i + 1];
+			if (format == "float")
+				settings.mPositionFormat = POSITIONFORMAT_FLOAT3;
+			else if (format == "half")
+				settings.mPositionFormat = POSITIONFORMAT_HALF4;
+			else
+				settings.mPositionFormat = POSITIONFORMAT_UNORM16X4;
+		}
+	}
+
 	const std::string path = "models";
 	for (const auto &entry : std::filesystem::directory_iterator(path))
 	{
+		if (entry.path().extension() != ".obj")
+			continue;
+
 		std::vector<Vertex> vertices;
 		std::vector<u32> indices;
+		std::vector<std::vector<u32>> lodIndices;
+		std::vector<MeshLod> lods;
+		std::vector<Meshlet> meshlets;
 
 		std::filesystem::path outputPath = entry.path();
 		outputPath.replace_extension("bin");
 
-		LoadModel(entry.path().string(), vertices, indices);
-		ExportModel(outputPath.string(), vertices, indices);
+		std::cout << entry.path().string() << std::endl;
+		LoadModel(entry.path().string(), settings.mWeld, vertices, indices);
+		SimplifyModel(settings, vertices, indices, lodIndices, lods);
+		OptimizeModel(settings, vertices, lodIndices, indices, lods);
+		ClusterModel(vertices, indices, lods, meshlets);
+		ExportModel(outputPath.string(), settings, vertices, indices, meshlets, lods);
 	}
 }